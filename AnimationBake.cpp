@@ -0,0 +1,336 @@
+#include "AnimationBake.hpp"
+
+#include "SceneCache.hpp"
+#include "helper/JobSystem.hpp"
+#include "lib/MappedFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+extern S72_scene s72_scene;
+
+namespace
+{
+    constexpr uint32_t Magic = 0x42323753; // "S72B" (little-endian)
+    constexpr uint32_t Version = 2;
+    constexpr uint32_t Components = 12; // glm::mat4x3
+    constexpr size_t ParallelNodes = 1024; // animated nodes per job in bake() / play()
+
+    void store_matrix(glm::mat4 const &m, float *out)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c * 3 + 0] = m[c][0];
+            out[c * 3 + 1] = m[c][1];
+            out[c * 3 + 2] = m[c][2];
+        }
+    }
+
+    // run fn(begin, end) over [0, count), in parallel if there's a job system:
+    template <typename Fn>
+    void for_ranges(JobSystem *jobs, size_t count, Fn const &fn)
+    {
+        if (jobs)
+            jobs->parallel_for(count, ParallelNodes, fn);
+        else if (count > 0)
+            fn(size_t(0), count);
+    }
+}
+
+size_t AnimationBake::bytes() const
+{
+    return samples.size() * sizeof(float) + quantized_samples.size() * sizeof(uint16_t) + (offset.size() + scale.size()) * sizeof(float);
+}
+
+void AnimationBake::bake(DriverBatch &drivers, float rate, bool quantize, JobSystem *jobs)
+{
+    *this = AnimationBake();
+    NodeHierarchy &hierarchy = s72_scene.hierarchy;
+    if (s72_scene.drivers.empty() || !(s72_scene.animation_duration > 0.0f) || !(rate > 0.0f))
+        return;
+
+    // every node in a driven subtree moves (difference array over the subtree ranges, so overlaps cost nothing):
+    std::vector<int32_t> depth(hierarchy.nodes.size() + 1, 0);
+    for (Driver const &driver : s72_scene.drivers)
+    {
+        if (driver.node_index < 0)
+            continue;
+        depth[driver.node_index] += 1;
+        depth[hierarchy.subtree_end[driver.node_index]] -= 1;
+    }
+    int32_t inside = 0;
+    for (uint32_t i = 0; i < hierarchy.nodes.size(); ++i)
+    {
+        inside += depth[i];
+        if (inside > 0)
+            nodes.emplace_back(i);
+    }
+    if (nodes.empty())
+        return;
+
+    duration = s72_scene.animation_duration;
+    frames = std::max(1u, uint32_t(std::ceil(duration * rate)));
+    quantized = quantize;
+
+    std::vector<NodeTRS> rest = hierarchy.local;
+    size_t count = nodes.size();
+    samples.resize(size_t(frames) * count * Components);
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        drivers.evaluate(duration * float(f) / float(frames), jobs);
+        hierarchy.update_world(jobs);
+        float *frame = &samples[size_t(f) * count * Components];
+        for_ranges(jobs, count, [&](size_t begin, size_t end)
+                   {
+                       for (size_t n = begin; n < end; ++n)
+                       {
+                           store_matrix(hierarchy.world[nodes[n]], frame + n * Components);
+                       } });
+    }
+
+    // put the scene back the way it was:
+    hierarchy.local = rest;
+    for (Driver const &driver : s72_scene.drivers)
+    {
+        if (driver.node_index >= 0)
+            hierarchy.mark_dirty(driver.node_index);
+    }
+    hierarchy.update_world(jobs);
+
+    if (quantize)
+    {
+        // each component of each node gets its own range, so static parts cost no precision:
+        offset.assign(count * Components, 0.0f);
+        scale.assign(count * Components, 0.0f);
+        quantized_samples.resize(samples.size());
+        for_ranges(jobs, count, [&](size_t begin, size_t end)
+                   {
+                       for (size_t n = begin; n < end; ++n)
+                       {
+                           for (uint32_t c = 0; c < Components; ++c)
+                           {
+                               float lo = samples[n * Components + c], hi = lo;
+                               for (uint32_t f = 1; f < frames; ++f)
+                               {
+                                   float v = samples[(size_t(f) * count + n) * Components + c];
+                                   lo = std::min(lo, v);
+                                   hi = std::max(hi, v);
+                               }
+                               offset[n * Components + c] = lo;
+                               scale[n * Components + c] = (hi - lo) / 65535.0f;
+                               float to_q = (hi > lo ? 65535.0f / (hi - lo) : 0.0f);
+                               for (uint32_t f = 0; f < frames; ++f)
+                               {
+                                   size_t i = (size_t(f) * count + n) * Components + c;
+                                   quantized_samples[i] = uint16_t(std::clamp(std::round((samples[i] - lo) * to_q), 0.0f, 65535.0f));
+                               }
+                           }
+                       } });
+        samples = std::vector<float>();
+    }
+}
+
+void AnimationBake::play(float time, JobSystem *jobs) const
+{
+    if (empty())
+        return;
+
+    // which two samples 'time' falls between (wrapping, since playback loops):
+    float position = time / duration * float(frames);
+    position -= std::floor(position / float(frames)) * float(frames);
+    uint32_t f0 = std::min(uint32_t(position), frames - 1);
+    uint32_t f1 = (f0 + 1 == frames ? 0 : f0 + 1);
+    float fraction = std::clamp(position - float(f0), 0.0f, 1.0f);
+
+    NodeHierarchy &hierarchy = s72_scene.hierarchy;
+    size_t count = nodes.size();
+    for_ranges(jobs, count, [&](size_t begin, size_t end)
+               {
+                   float a[Components], b[Components];
+                   for (size_t n = begin; n < end; ++n)
+                   {
+                       size_t i0 = (size_t(f0) * count + n) * Components;
+                       size_t i1 = (size_t(f1) * count + n) * Components;
+                       if (quantized)
+                       {
+                           for (uint32_t c = 0; c < Components; ++c)
+                           {
+                               a[c] = offset[n * Components + c] + float(quantized_samples[i0 + c]) * scale[n * Components + c];
+                               b[c] = offset[n * Components + c] + float(quantized_samples[i1 + c]) * scale[n * Components + c];
+                           }
+                       }
+                       else
+                       {
+                           std::memcpy(a, &samples[i0], sizeof(a));
+                           std::memcpy(b, &samples[i1], sizeof(b));
+                       }
+                       glm::mat4 &world = hierarchy.world[nodes[n]];
+                       for (int col = 0; col < 4; ++col)
+                       {
+                           for (int row = 0; row < 3; ++row)
+                           {
+                               float va = a[col * 3 + row];
+                               world[col][row] = va + (b[col * 3 + row] - va) * fraction;
+                           }
+                           world[col][3] = (col == 3 ? 1.0f : 0.0f);
+                       }
+                   } });
+}
+
+//------------------------------------------
+
+std::string AnimationBake::path_for(std::string const &s72_path)
+{
+    return s72_path + ".bake";
+}
+
+bool AnimationBake::load(std::string const &s72_path, float rate, bool quantize, bool compressed)
+{
+    *this = AnimationBake();
+    std::string bake_path = path_for(s72_path);
+    MappedFile file;
+    if (!file.map(bake_path))
+        return false;
+
+    char const *at = file.data;
+    char const *end = file.data + file.size;
+    auto read = [&](void *out, size_t size)
+    {
+        if (size_t(end - at) < size)
+            throw std::runtime_error("animation bake is truncated");
+        if (size != 0)
+            std::memcpy(out, at, size);
+        at += size;
+    };
+    auto pod = [&]<typename T>(T *out)
+    { read(out, sizeof(T)); };
+
+    try
+    {
+        uint32_t magic, version, is_quantized, is_compressed, node_count, hierarchy_size;
+        uint64_t hash;
+        float baked_rate;
+        pod(&magic);
+        pod(&version);
+        pod(&hash);
+        pod(&baked_rate);
+        pod(&is_quantized);
+        pod(&is_compressed);
+        if (magic != Magic || version != Version || baked_rate != rate || (is_quantized != 0) != quantize || (is_compressed != 0) != compressed)
+        {
+            std::cout << "Animation bake " << bake_path << " is from a different version or options; rebaking.\n";
+            return false;
+        }
+        if (hash != SceneCache::hash_sources(s72_path, {}))
+        {
+            std::cout << "Animation bake " << bake_path << " is out of date; rebaking.\n";
+            return false;
+        }
+
+        pod(&frames);
+        pod(&duration);
+        pod(&hierarchy_size);
+        pod(&node_count);
+        if (hierarchy_size != s72_scene.hierarchy.nodes.size() || node_count > hierarchy_size || frames == 0)
+            throw std::runtime_error("animation bake doesn't match the scene");
+        nodes.resize(node_count);
+        read(nodes.data(), nodes.size() * sizeof(uint32_t));
+        for (uint32_t node : nodes)
+        {
+            if (node >= hierarchy_size)
+                throw std::runtime_error("animation bake has an out-of-range node");
+        }
+
+        size_t values = size_t(frames) * node_count * Components;
+        if (values / Components / node_count != frames && node_count != 0)
+            throw std::runtime_error("animation bake is too big");
+        quantized = quantize;
+        if (quantized)
+        {
+            offset.resize(size_t(node_count) * Components);
+            scale.resize(size_t(node_count) * Components);
+            read(offset.data(), offset.size() * sizeof(float));
+            read(scale.data(), scale.size() * sizeof(float));
+            if (size_t(end - at) < values * sizeof(uint16_t))
+                throw std::runtime_error("animation bake is truncated");
+            quantized_samples.resize(values);
+            read(quantized_samples.data(), values * sizeof(uint16_t));
+        }
+        else
+        {
+            if (size_t(end - at) < values * sizeof(float))
+                throw std::runtime_error("animation bake is truncated");
+            samples.resize(values);
+            read(samples.data(), values * sizeof(float));
+        }
+    }
+    catch (std::exception const &e)
+    {
+        std::cerr << "Ignoring animation bake " << bake_path << ": " << e.what() << std::endl;
+        *this = AnimationBake();
+        return false;
+    }
+
+    std::cout << "Using animation bake " << bake_path << ".\n";
+    return true;
+}
+
+void AnimationBake::save(std::string const &s72_path, float rate, bool compressed) const
+{
+    std::string bake_path = path_for(s72_path);
+    std::string temp_path = bake_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary);
+        auto write = [&](void const *data, size_t size)
+        { out.write(reinterpret_cast<char const *>(data), std::streamsize(size)); };
+
+        uint32_t header[2] = {Magic, Version};
+        write(header, sizeof(header));
+        uint64_t hash = SceneCache::hash_sources(s72_path, {});
+        write(&hash, sizeof(hash));
+        write(&rate, sizeof(rate));
+        uint32_t is_quantized = quantized ? 1 : 0;
+        write(&is_quantized, sizeof(is_quantized));
+        uint32_t is_compressed = compressed ? 1 : 0;
+        write(&is_compressed, sizeof(is_compressed));
+        write(&frames, sizeof(frames));
+        write(&duration, sizeof(duration));
+        uint32_t hierarchy_size = uint32_t(s72_scene.hierarchy.nodes.size());
+        write(&hierarchy_size, sizeof(hierarchy_size));
+        uint32_t node_count = uint32_t(nodes.size());
+        write(&node_count, sizeof(node_count));
+        write(nodes.data(), nodes.size() * sizeof(uint32_t));
+        if (quantized)
+        {
+            write(offset.data(), offset.size() * sizeof(float));
+            write(scale.data(), scale.size() * sizeof(float));
+            write(quantized_samples.data(), quantized_samples.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            write(samples.data(), samples.size() * sizeof(float));
+        }
+        if (!out)
+        {
+            std::cerr << "Failed to write animation bake " << temp_path << std::endl;
+            out.close();
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+    // (renamed into place, so a crash never leaves a half-written bake behind)
+    std::error_code ec;
+    std::filesystem::rename(temp_path, bake_path, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to write animation bake " << bake_path << ": " << ec.message() << std::endl;
+        std::remove(temp_path.c_str());
+        return;
+    }
+    std::cout << "Wrote animation bake " << bake_path << ".\n";
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "DriverBatch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// World transforms of every animated node (each driver's target and all its descendants), sampled at a fixed
+//  rate across s72_scene.animation_duration. Playback is then a blend of two samples per node, instead of
+//  driver evaluation plus hierarchy propagation. Samples are 4x3 matrices, stored as floats or (quantized)
+//  as 16-bit fractions of each component's range over the animation. Saved beside the .s72 as "<scene>.s72.bake".
+struct AnimationBake
+{
+    uint32_t frames = 0;     // samples, evenly spaced over [0, duration) (the last one blends back into the first)
+    float duration = 0.0f;   // s72_scene.animation_duration when baked
+    bool quantized = false;
+    std::vector<uint32_t> nodes; // animated nodes (s72_scene.hierarchy indices, ascending)
+
+    // [frame * nodes.size() + n] is 12 components (glm::mat4x3, column-major) for nodes[n] at frame:
+    std::vector<float> samples;            // (if !quantized)
+    std::vector<uint16_t> quantized_samples; // (if quantized) component = offset + q * scale
+    std::vector<float> offset, scale;      // (if quantized) [n * 12 + c]
+
+    bool empty() const { return frames == 0; }
+    size_t bytes() const; // size of the sample data
+
+    // sample the current scene (through 'drivers', which must be built) 'rate' times per second; leaves the
+    //  hierarchy's local transforms as they were and its world transforms up to date:
+    void bake(DriverBatch &drivers, float rate, bool quantize, JobSystem *jobs = nullptr);
+
+    // write world transforms of the animated nodes at 'time' (wrapped to the animation) into s72_scene.hierarchy.world:
+    void play(float time, JobSystem *jobs = nullptr) const;
+
+    // "<scene>.s72.bake"; load() only accepts a bake made from the same .s72 with the same rate and quantization,
+    //  and from drivers that were (or weren't) put through compress_drivers, as 'compressed' says:
+    static std::string path_for(std::string const &s72_path);
+    bool load(std::string const &s72_path, float rate, bool quantize, bool compressed);
+    void save(std::string const &s72_path, float rate, bool compressed) const; // (failure is reported, not fatal)
+};
@@ -0,0 +1,189 @@
+#include "BoxBatch.hpp"
+
+#include "lib/Wide.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+//------------------------------------------
+// SIMD lanes (lib/Wide.hpp), and helpers for the kernels:
+
+namespace
+{
+    using namespace simd;
+
+    // one box of BoxBatch::transform, in plain floats (for ranges that don't fill a register; same arithmetic):
+    void transform_one(glm::mat4 const &m, float const in[6], float out[6])
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            float world_center = m[3][r];
+            float world_extent = 0.0f;
+            for (int c = 0; c < 3; ++c)
+            {
+                float center = in[c] * 0.5f + in[3 + c] * 0.5f;
+                float extent = in[3 + c] * 0.5f - in[c] * 0.5f;
+                world_center = world_center + m[c][r] * center;
+                world_extent = world_extent + std::abs(m[c][r]) * extent;
+            }
+            out[r] = world_center - world_extent;
+            out[3 + r] = world_center + world_extent;
+        }
+    }
+}
+
+uint32_t const BoxBatch::Width = WideLanes;
+
+void BoxBatch::resize(uint32_t count_)
+{
+    uint32_t kept = std::min(count, count_);
+    count = count_;
+    size_t size = size_t(count) + WideLanes; // (so a register loaded at any box stays in bounds)
+    for (std::vector<float> *array : {&min_x, &min_y, &min_z})
+    {
+        array->resize(size);
+        std::fill(array->begin() + kept, array->end(), FLT_MAX);
+    }
+    for (std::vector<float> *array : {&max_x, &max_y, &max_z})
+    {
+        array->resize(size);
+        std::fill(array->begin() + kept, array->end(), -FLT_MAX);
+    }
+}
+
+BBox BoxBatch::get(uint32_t i) const
+{
+    assert(i < count);
+    return BBox(glm::vec3(min_x[i], min_y[i], min_z[i]), glm::vec3(max_x[i], max_y[i], max_z[i]));
+}
+
+void BoxBatch::set(uint32_t i, BBox const &box)
+{
+    assert(i < count);
+    min_x[i] = box.min.x;
+    min_y[i] = box.min.y;
+    min_z[i] = box.min.z;
+    max_x[i] = box.max.x;
+    max_y[i] = box.max.y;
+    max_z[i] = box.max.z;
+}
+
+//------------------------------------------
+// kernels:
+
+void BoxBatch::transform(glm::mat4 const *matrices, uint32_t const *matrix_index, uint32_t begin, uint32_t end, BoxBatch *out) const
+{
+    assert(out && end <= count && end <= out->count);
+    float const *in_arrays[6] = {min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data()};
+    float *out_arrays[6] = {out->min_x.data(), out->min_y.data(), out->min_z.data(), out->max_x.data(), out->max_y.data(), out->max_z.data()};
+
+    Wide const half = splat(0.5f);
+    Wide const magnitude = splat(std::bit_cast<float>(0x7fffffffu));
+    uint32_t i = begin;
+    for (; i + WideLanes <= end; i += WideLanes)
+    {
+        // gather each lane's matrix into component registers ([column * 3 + row] of the upper 4x3):
+        alignas(32) float lanes[12][WideLanes];
+        for (uint32_t l = 0; l < WideLanes; ++l)
+        {
+            glm::mat4 const &m = matrices[matrix_index[i + l]];
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int r = 0; r < 3; ++r)
+                {
+                    lanes[c * 3 + r][l] = m[c][r];
+                }
+            }
+        }
+
+        // center and extent, computed as halves so empty boxes (+-FLT_MAX) never overflow into infinity * 0:
+        Wide center[3], extent[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            Wide lo = load(in_arrays[c] + i);
+            Wide hi = load(in_arrays[3 + c] + i);
+            center[c] = add(mul(lo, half), mul(hi, half));
+            extent[c] = sub(mul(hi, half), mul(lo, half));
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+            Wide world_center = load(lanes[9 + r]);
+            Wide world_extent = splat(0.0f);
+            for (int c = 0; c < 3; ++c)
+            {
+                Wide m = load(lanes[c * 3 + r]);
+                world_center = add(world_center, mul(m, center[c]));
+                world_extent = add(world_extent, mul(bit_and(m, magnitude), extent[c]));
+            }
+            store(out_arrays[r] + i, sub(world_center, world_extent));
+            store(out_arrays[3 + r] + i, add(world_center, world_extent));
+        }
+    }
+    for (; i < end; ++i)
+    {
+        float in[6], result[6];
+        for (int a = 0; a < 6; ++a)
+        {
+            in[a] = in_arrays[a][i];
+        }
+        transform_one(matrices[matrix_index[i]], in, result);
+        for (int a = 0; a < 6; ++a)
+        {
+            out_arrays[a][i] = result[a];
+        }
+    }
+}
+
+void BoxBatch::cull(std::array<Plane, 6> const &planes, uint32_t mask, uint32_t begin, uint32_t end, uint32_t const *index,
+                    std::vector<uint32_t> *visible) const
+{
+    assert(visible && end <= count);
+
+    // each plane tests the box corner farthest along its normal, so pick that corner's arrays once per plane:
+    struct Test
+    {
+        Wide nx, ny, nz, distance;
+        float const *x, *y, *z;
+    };
+    std::array<Test, 6> tests;
+    uint32_t test_count = 0;
+    for (uint32_t p = 0; p < 6; ++p)
+    {
+        if (!(mask & (1u << p)))
+            continue;
+        glm::vec3 n = planes[p].normal;
+        tests[test_count++] = Test{
+            .nx = splat(n.x),
+            .ny = splat(n.y),
+            .nz = splat(n.z),
+            .distance = splat(planes[p].distance),
+            .x = (n.x > 0 ? max_x.data() : min_x.data()),
+            .y = (n.y > 0 ? max_y.data() : min_y.data()),
+            .z = (n.z > 0 ? max_z.data() : min_z.data()),
+        };
+    }
+
+    Wide const zero = splat(0.0f);
+    for (uint32_t i = begin; i < end; i += WideLanes)
+    {
+        // (padding and boxes past 'end' are loaded, then dropped from the lane bits)
+        Wide outside = splat(std::bit_cast<float>(0u));
+        for (uint32_t t = 0; t < test_count; ++t)
+        {
+            Test const &test = tests[t];
+            // (same arithmetic as glm::dot(normal, corner) + distance)
+            Wide dot = add(add(mul(test.nx, load(test.x + i)), mul(test.ny, load(test.y + i))), mul(test.nz, load(test.z + i)));
+            outside = bit_or(outside, less(add(dot, test.distance), zero));
+        }
+        uint32_t lanes = std::min(WideLanes, end - i);
+        uint32_t bits = ~sign_bits(outside) & ((1u << lanes) - 1u);
+        while (bits)
+        {
+            visible->emplace_back(index[i + std::countr_zero(bits)]);
+            bits &= bits - 1u;
+        }
+    }
+}
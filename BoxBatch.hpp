@@ -0,0 +1,33 @@
+#pragma once
+
+#include "lib/bbox.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Axis-aligned boxes stored structure-of-arrays (one array per min / max component), with kernels that work on a
+//  SIMD register's worth of boxes at a time: transforming boxes by a matrix per box, and testing boxes against
+//  frustum planes, appending the survivors to a compact index list.
+//  Lanes are 8 wide when built with AVX2, 4 wide with SSE2 (any x86-64), and 1 elsewhere (as DriverBatch).
+struct BoxBatch
+{
+    std::vector<float> min_x, min_y, min_z; // [box], with Width boxes of (empty) padding at the end
+    std::vector<float> max_x, max_y, max_z;
+    uint32_t count = 0;
+
+    static uint32_t const Width; // lanes per SIMD register in this build
+
+    void resize(uint32_t count); // (added boxes are empty)
+    BBox get(uint32_t i) const;
+    void set(uint32_t i, BBox const &box);
+
+    // out's boxes [begin, end) = these boxes transformed by matrices[matrix_index[i]] (the same bounds as
+    //  BBox::transform, computed from center and extent; empty boxes stay empty); out may be this:
+    void transform(glm::mat4 const *matrices, uint32_t const *matrix_index, uint32_t begin, uint32_t end, BoxBatch *out) const;
+
+    // append index[i] to *visible for every box i in [begin, end) that is not entirely behind one of the planes
+    //  selected by 'mask' (bit p selects planes[p]; the same test as BBox::is_bbox_outside_frustum):
+    void cull(std::array<Plane, 6> const &planes, uint32_t mask, uint32_t begin, uint32_t end, uint32_t const *index,
+              std::vector<uint32_t> *visible) const;
+};
@@ -0,0 +1,345 @@
+#include "DriverBatch.hpp"
+
+#include "helper/JobSystem.hpp"
+#include "lib/Wide.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+extern S72_scene s72_scene;
+
+//------------------------------------------
+// SIMD lanes (lib/Wide.hpp), and helpers for the kernels:
+
+namespace
+{
+    using namespace simd;
+
+    // acos(x) for x in [0,1] (Abramowitz & Stegun 4.4.46, |error| <= 2e-8):
+    inline Wide acos_01(Wide x)
+    {
+        Wide p = splat(-0.0012624911f);
+        p = add(mul(p, x), splat(0.0066700901f));
+        p = add(mul(p, x), splat(-0.0170881256f));
+        p = add(mul(p, x), splat(0.0308918810f));
+        p = add(mul(p, x), splat(-0.0501743046f));
+        p = add(mul(p, x), splat(0.0889789874f));
+        p = add(mul(p, x), splat(-0.2145988016f));
+        p = add(mul(p, x), splat(1.5707963050f));
+        return mul(sqrt(sub(splat(1.0f), x)), p);
+    }
+
+    // sin(x) for x in [0,pi/2] (Taylor series through x^11, |error| < 6e-8):
+    inline Wide sin_0pi2(Wide x)
+    {
+        Wide x2 = mul(x, x);
+        Wide p = splat(-1.0f / 39916800.0f);
+        p = add(mul(p, x2), splat(1.0f / 362880.0f));
+        p = add(mul(p, x2), splat(-1.0f / 5040.0f));
+        p = add(mul(p, x2), splat(1.0f / 120.0f));
+        p = add(mul(p, x2), splat(-1.0f / 6.0f));
+        p = add(mul(p, x2), splat(1.0f));
+        return mul(x, p);
+    }
+
+    // acos(x) for x in [-1,1]:
+    inline Wide acos_11(Wide x)
+    {
+        Wide negative = greater(splat(0.0f), x);
+        Wide angle = acos_01(min(bit_xor(x, bit_and(x, splat(-0.0f))), splat(1.0f)));
+        return select(negative, sub(splat(3.14159265f), angle), angle);
+    }
+
+    // sin(x) for x in [0,pi] (by symmetry about pi/2):
+    inline Wide sin_0pi(Wide x)
+    {
+        return sin_0pi2(min(x, sub(splat(3.14159265f), x)));
+    }
+
+    // spherical interpolation of rotations, as glm::slerp (shortest: negate 'to' where the rotations are more than
+    //  180 degrees apart) or glm::mix (not shortest: blend along whichever arc the quaternions span):
+    void blend_rotations(bool shortest, uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out)
+    {
+        Wide const one = splat(1.0f);
+        Wide const sign_bit = splat(-0.0f);
+        Wide const nearly_parallel = splat(1.0f - std::numeric_limits<float>::epsilon());
+        for (uint32_t i = 0; i < count; i += WideLanes)
+        {
+            Wide a[4], b[4];
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                a[c] = load(from + c * stride + i);
+                b[c] = load(to + c * stride + i);
+            }
+            Wide t = load(fraction + i);
+
+            Wide cos = add(add(mul(a[0], b[0]), mul(a[1], b[1])), add(mul(a[2], b[2]), mul(a[3], b[3])));
+            if (shortest)
+            {
+                Wide flip = bit_and(cos, sign_bit);
+                cos = bit_xor(cos, flip);
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    b[c] = bit_xor(b[c], flip);
+                }
+            }
+            cos = min(cos, one);
+
+            Wide angle = acos_11(cos);
+            Wide inv_sin = div(one, sin_0pi(angle));
+            Wide weight_a = mul(sin_0pi(mul(sub(one, t), angle)), inv_sin);
+            Wide weight_b = mul(sin_0pi(mul(t, angle)), inv_sin);
+            // nearly the same rotation: blend linearly, as glm::slerp and glm::mix do (and don't divide by ~0):
+            Wide linear = greater(cos, nearly_parallel);
+            weight_a = select(linear, sub(one, t), weight_a);
+            weight_b = select(linear, t, weight_b);
+
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                store(out + c * stride + i, add(mul(a[c], weight_a), mul(b[c], weight_b)));
+            }
+        }
+    }
+}
+
+uint32_t const DriverBatch::Width = WideLanes;
+
+//------------------------------------------
+// kernels:
+
+void DriverBatch::lerp(uint32_t dim, uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out)
+{
+    Wide const one = splat(1.0f);
+    for (uint32_t i = 0; i < count; i += WideLanes)
+    {
+        Wide t = load(fraction + i);
+        Wide s = sub(one, t);
+        for (uint32_t c = 0; c < dim; ++c)
+        {
+            // (same arithmetic as glm::mix of vec3s, so translation and scale match the scalar path exactly)
+            Wide a = load(from + c * stride + i);
+            Wide b = load(to + c * stride + i);
+            store(out + c * stride + i, add(mul(a, s), mul(b, t)));
+        }
+    }
+}
+
+void DriverBatch::slerp(uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out)
+{
+    blend_rotations(true, count, stride, from, to, fraction, out);
+}
+
+void DriverBatch::mix_rotations(uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out)
+{
+    blend_rotations(false, count, stride, from, to, fraction, out);
+}
+
+//------------------------------------------
+
+void DriverBatch::build()
+{
+    groups.clear();
+
+    for (uint32_t d = 0; d < s72_scene.drivers.size(); ++d)
+    {
+        Driver const &driver = s72_scene.drivers[d];
+        if (driver.node_index < 0 || driver.times.empty())
+            continue;
+        if (!(driver.channel == ROTATION ? driver.channel_dim == 4 : driver.channel_dim == 3))
+            continue; // (make_animation ignores these too)
+
+        Kind kind = Lerp;
+        if (driver.interpolation == STEP)
+            kind = Step;
+        else if (driver.interpolation == SLERP && driver.channel == ROTATION)
+            kind = Slerp;
+        else if (driver.channel == ROTATION)
+            kind = Mix;
+
+        auto group = std::find_if(groups.begin(), groups.end(), [&](Group const &g)
+                                  { return g.channel == driver.channel && g.kind == kind; });
+        if (group == groups.end())
+        {
+            groups.emplace_back();
+            group = groups.end() - 1;
+            group->channel = driver.channel;
+            group->kind = kind;
+            group->dim = driver.channel_dim;
+        }
+        group->drivers.push_back(d);
+        group->targets.push_back(driver.node_index);
+    }
+
+    for (Group &group : groups)
+    {
+        uint32_t lanes = uint32_t(group.drivers.size());
+        group.stride = (lanes + WideLanes - 1) / WideLanes * WideLanes;
+        // padding lanes blend identity into identity (and are never scattered):
+        group.from.assign(size_t(group.dim) * group.stride, 0.0f);
+        if (group.channel == ROTATION)
+            std::fill(group.from.begin() + 3 * group.stride, group.from.end(), 1.0f);
+        group.to = group.from;
+        group.out = group.from;
+        group.fraction.assign(group.stride, 0.0f);
+    }
+}
+
+void DriverBatch::evaluate_lanes(Group &group, float time, uint32_t begin, uint32_t end)
+{
+    uint32_t stride = group.stride;
+
+    // gather the keyframes on either side of 'time' (STEP groups just copy the earlier one out):
+    float *from = (group.kind == Step ? group.out.data() : group.from.data());
+    for (uint32_t l = begin; l < end; ++l)
+    {
+        Driver &driver = s72_scene.drivers[group.drivers[l]];
+        uint32_t a, b;
+        group.fraction[l] = driver.find_segment(time, &a, &b);
+        float va[4], vb[4];
+        driver.key_value(a, va);
+        if (group.kind != Step)
+            driver.key_value(b, vb);
+        for (uint32_t c = 0; c < group.dim; ++c)
+        {
+            from[c * stride + l] = va[c];
+        }
+        if (group.kind == Step)
+            continue;
+        for (uint32_t c = 0; c < group.dim; ++c)
+        {
+            group.to[c * stride + l] = vb[c];
+        }
+    }
+
+    // (begin is a multiple of Width, and stride leaves room to round the count up to one)
+    uint32_t count = (end - begin + WideLanes - 1) / WideLanes * WideLanes;
+    if (group.kind == Lerp)
+        lerp(group.dim, count, stride, group.from.data() + begin, group.to.data() + begin, group.fraction.data() + begin, group.out.data() + begin);
+    else if (group.kind == Slerp)
+        slerp(count, stride, group.from.data() + begin, group.to.data() + begin, group.fraction.data() + begin, group.out.data() + begin);
+    else if (group.kind == Mix)
+        mix_rotations(count, stride, group.from.data() + begin, group.to.data() + begin, group.fraction.data() + begin, group.out.data() + begin);
+
+    // scatter into the node transforms:
+    NodeHierarchy &hierarchy = s72_scene.hierarchy;
+    float const *out = group.out.data();
+    for (uint32_t l = begin; l < end; ++l)
+    {
+        NodeTRS &local = hierarchy.local[group.targets[l]];
+        if (group.channel == TRANSLATION)
+            local.position = glm::vec3(out[l], out[stride + l], out[2 * stride + l]);
+        else if (group.channel == SCALE)
+            local.scale = glm::vec3(out[l], out[stride + l], out[2 * stride + l]);
+        else
+            local.rotation = glm::quat(out[3 * stride + l], out[l], out[stride + l], out[2 * stride + l]); // (n.b. wxyz)
+    }
+}
+
+void DriverBatch::evaluate(float time, JobSystem *jobs)
+{
+    static_assert(ParallelLanes % 8 == 0, "parallel blocks must start on a lane multiple of every SIMD width");
+
+    for (Group &group : groups)
+    {
+        uint32_t lanes = uint32_t(group.drivers.size());
+        if (jobs == nullptr || lanes <= ParallelLanes)
+        {
+            evaluate_lanes(group, time, 0, lanes);
+            continue;
+        }
+        jobs->parallel_for((lanes + ParallelLanes - 1) / ParallelLanes, 1, [&](size_t begin, size_t end)
+                           {
+                               for (size_t block = begin; block < end; ++block)
+                               {
+                                   uint32_t first = uint32_t(block) * ParallelLanes;
+                                   evaluate_lanes(group, time, first, std::min(lanes, first + ParallelLanes));
+                               } });
+    }
+
+    // (serially, since the dirty list isn't thread-safe)
+    for (Group const &group : groups)
+    {
+        for (int32_t target : group.targets)
+        {
+            s72_scene.hierarchy.mark_dirty(target);
+        }
+    }
+}
+
+//------------------------------------------
+
+void DriverBatch::benchmark(uint32_t frames)
+{
+    NodeHierarchy &hierarchy = s72_scene.hierarchy;
+    if (s72_scene.drivers.empty() || frames == 0)
+    {
+        std::cout << "Animation benchmark: scene has no drivers." << std::endl;
+        return;
+    }
+    std::vector<NodeTRS> rest = hierarchy.local;
+    auto time_at = [&](uint32_t f)
+    { return s72_scene.animation_duration * float(f) / float(frames); };
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto before = Clock::now();
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        for (auto &driver : s72_scene.drivers)
+        {
+            driver.make_animation(time_at(f));
+        }
+    }
+    auto middle = Clock::now();
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        evaluate(time_at(f));
+    }
+    auto after = Clock::now();
+
+    // (untimed) compare the two paths frame by frame:
+    float max_difference = 0.0f;
+    std::vector<NodeTRS> expected;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        for (auto &driver : s72_scene.drivers)
+        {
+            driver.make_animation(time_at(f));
+        }
+        expected = hierarchy.local;
+        evaluate(time_at(f));
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            NodeTRS const &a = expected[i];
+            NodeTRS const &b = hierarchy.local[i];
+            for (int c = 0; c < 3; ++c)
+            {
+                max_difference = std::max(max_difference, std::abs(a.position[c] - b.position[c]));
+                max_difference = std::max(max_difference, std::abs(a.scale[c] - b.scale[c]));
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                max_difference = std::max(max_difference, std::abs(a.rotation[c] - b.rotation[c]));
+            }
+        }
+    }
+
+    hierarchy.local = rest;
+    hierarchy.update_world(); // (everything animated is still marked dirty)
+
+    uint32_t lanes = 0;
+    for (Group const &group : groups)
+    {
+        lanes += uint32_t(group.drivers.size());
+    }
+    double scalar_ms = std::chrono::duration<double, std::milli>(middle - before).count() / frames;
+    double batch_ms = std::chrono::duration<double, std::milli>(after - middle).count() / frames;
+    std::cout << "Animation benchmark: " << s72_scene.drivers.size() << " drivers (" << lanes << " in " << groups.size()
+              << " groups, " << Width << " lanes wide), " << frames << " frames:\n"
+              << "  scalar  " << scalar_ms << " ms/frame\n"
+              << "  batched " << batch_ms << " ms/frame (" << (batch_ms > 0.0 ? scalar_ms / batch_ms : 0.0) << "x)\n"
+              << "  largest difference " << max_difference << std::endl;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Scene.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Evaluates every driver in s72_scene.drivers per frame, a SIMD register's worth of channels at a time.
+//  Drivers are grouped by (channel, kind); each frame, a group's keyframe pairs and fractions are gathered into
+//  per-component lanes, blended with one wide kernel (lerp, or slerp / mix_rotations for rotations), and scattered
+//  straight into s72_scene.hierarchy.local. Results match Driver::make_animation (rotations to within float rounding).
+//  Lanes are 8 wide when built with AVX2 (e.g. -mavx2 or /arch:AVX2), 4 wide with SSE2 (any x86-64), and 1 elsewhere.
+struct DriverBatch
+{
+    enum Kind : uint8_t
+    {
+        Step,  // hold the earlier keyframe (no kernel)
+        Lerp,  // component-wise mix of vec3 channels (like glm::mix)
+        Slerp, // shortest-path spherical interpolation of rotations (like glm::slerp)
+        Mix,   // spherical interpolation of LINEAR rotations, without the shortest-path flip (like glm::mix of quats)
+    };
+
+    struct Group
+    {
+        DriverChannleType channel;
+        Kind kind;
+        uint32_t dim;                 // 3 (translation, scale) or 4 (rotation, stored xyzw)
+        std::vector<uint32_t> drivers; // index into s72_scene.drivers of each lane
+        std::vector<int32_t> targets;  // index into s72_scene.hierarchy of each lane
+
+        uint32_t stride = 0;     // lanes per component, rounded up to the SIMD width (padding lanes blend identity)
+        std::vector<float> from; // [component * stride + lane], likewise:
+        std::vector<float> to;
+        std::vector<float> out;
+        std::vector<float> fraction; // [lane]
+    };
+    std::vector<Group> groups;
+
+    static uint32_t const Width; // lanes per SIMD register in this build
+
+    // (re)group s72_scene.drivers; call after build_node_hierarchy, which resolves (and sorts drivers by) Driver::node_index
+    //  (drivers without a placed target node are skipped; each group's lanes stay in target order):
+    void build();
+    // evaluate every driver at 'time', writing into (and marking dirty) s72_scene.hierarchy.local
+    //  (with a job system, big groups are split into blocks of ParallelLanes lanes evaluated in parallel):
+    void evaluate(float time, JobSystem *jobs = nullptr);
+    void evaluate_lanes(Group &group, float time, uint32_t begin, uint32_t end); // lanes [begin, end) of one group (begin a multiple of Width)
+
+    static constexpr uint32_t ParallelLanes = 256;
+
+    // kernels (count is a multiple of Width; arrays hold 'count' floats per component, 'stride' apart):
+    static void lerp(uint32_t dim, uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out);
+    static void slerp(uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out);
+    static void mix_rotations(uint32_t count, uint32_t stride, float const *from, float const *to, float const *fraction, float *out);
+
+    // time 'frames' evaluations spread over the animation with both the scalar path and evaluate(), print the
+    //  timings and largest difference, then put s72_scene.hierarchy back the way it was (`--benchmark-animation`):
+    void benchmark(uint32_t frames);
+};
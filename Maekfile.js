@@ -28,14 +28,22 @@ custom_flags_and_rules();
 // it returns the path to the output object file
 const main_objs = [
 	maek.CPP('Scene.cpp'),
+	maek.CPP('SceneCache.cpp'),
+	maek.CPP('DriverBatch.cpp'),
+	maek.CPP('AnimationBake.cpp'),
+	maek.CPP('BoxBatch.cpp'),
+	maek.CPP('SceneBVH.cpp'),
+	maek.CPP('OcclusionBuffer.cpp'),
 	//maek.CPP('controllers/Mode.cpp'),
 	//maek.CPP('controllers/PlayMode.cpp'),
 	maek.CPP('Tutorial.cpp'),
 	maek.CPP('lib/PosColVertex.cpp'),
 	maek.CPP('lib/PosNorTexVertex.cpp'),
 	maek.CPP('lib/SceneVertex.cpp'),
+	maek.CPP('lib/MappedFile.cpp'),
 	maek.CPP('RTG.cpp'),
 	maek.CPP('helper/Helpers.cpp'),
+	maek.CPP('helper/JobSystem.cpp'),
 	maek.CPP('main.cpp'),
 	maek.CPP('include/sejp/sejp.cpp'),
 ];
@@ -68,9 +76,29 @@ main_objs.push( maek.CPP('pipelines/Tutorial-ObjectsPipeline.cpp', undefined, {
 const real_objects_shaders = [
 	maek.GLSLC('./shaders/real_objects.vert'),
 	maek.GLSLC('./shaders/real_objects.frag'),
+	maek.GLSLC('./shaders/real_objects_depth.vert'),
 ];
 main_objs.push( maek.CPP('pipelines/ScenesPipeline.cpp', undefined, { depends:[...real_objects_shaders] } ) );
 
+//to build transform propagation shader and pipeline:
+const transforms_shaders = [
+	maek.GLSLC('./shaders/transforms.comp'),
+];
+main_objs.push( maek.CPP('pipelines/TransformsPipeline.cpp', undefined, { depends:[...transforms_shaders] } ) );
+
+//to build GPU culling shader and pipeline:
+const cull_shaders = [
+	maek.GLSLC('./shaders/cull.comp'),
+	maek.GLSLC('./shaders/cull.comp', 'spv/shaders/cull_occlusion.comp', { GLSLCFlags:['-DOCCLUSION'] }),
+];
+main_objs.push( maek.CPP('pipelines/CullPipeline.cpp', undefined, { depends:[...cull_shaders] } ) );
+
+//to build depth pyramid shader and pipeline:
+const depth_pyramid_shaders = [
+	maek.GLSLC('./shaders/depth_pyramid.comp'),
+];
+main_objs.push( maek.CPP('pipelines/DepthPyramidPipeline.cpp', undefined, { depends:[...depth_pyramid_shaders] } ) );
+
 //to build headless shaders and pipeline:
 const headless_shaders = [
 	maek.GLSLC('./shaders/headless.comp'),
@@ -112,12 +140,14 @@ function custom_flags_and_rules() {
 
 		maek.options.CPPFlags = [
 			'-O2',
+			'-pthread',
 			`-I${VULKAN_SDK}/include`,
 			`-I${GLFW_DIR}/include`
 		];
 
 		maek.options.LINKLibs = [
 			'-O2',
+			'-pthread',
 			`-L${VULKAN_SDK}/lib`,
 			`-L${GLFW_DIR}/lib`,
 			'-lX11',
@@ -0,0 +1,274 @@
+#include "OcclusionBuffer.hpp"
+
+#include "helper/JobSystem.hpp"
+#include "lib/Wide.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+//------------------------------------------
+// SIMD lanes (lib/Wide.hpp), and helpers for the kernels:
+
+namespace
+{
+    using namespace simd;
+
+    constexpr uint32_t AllLanes = (1u << WideLanes) - 1u;
+    static_assert(OcclusionBuffer::Width % 8 == 0, "rows hold a whole number of registers at every width");
+
+    // bits of the lanes in [begin, end) (either may be past the register's ends):
+    inline uint32_t lane_bits(int32_t begin, int32_t end)
+    {
+        begin = std::max(begin, 0);
+        end = std::min(end, int32_t(WideLanes));
+        if (begin >= end)
+            return 0u;
+        return ((1u << end) - 1u) & ~((1u << begin) - 1u);
+    }
+
+    // pixel-space position (and depth) of a clip-space point:
+    inline glm::vec3 to_pixels(glm::vec4 const &clip)
+    {
+        return glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * float(OcclusionBuffer::Width),
+                         (clip.y / clip.w * 0.5f + 0.5f) * float(OcclusionBuffer::Height),
+                         clip.z / clip.w);
+    }
+}
+
+bool OcclusionBuffer::add_occluder(uint32_t matrix, std::vector<glm::vec3> const &triangle_corners)
+{
+    assert(triangle_corners.size() % 3 == 0);
+    uint32_t count = uint32_t(triangle_corners.size() / 3);
+    uint32_t first = uint32_t(corners.size() / 3);
+    if (count == 0 || occluders.size() >= MaxOccluders || first + count > TriangleBudget)
+        return false;
+    occluders.emplace_back(Occluder{.matrix = matrix, .first = first, .count = count});
+    corners.insert(corners.end(), triangle_corners.begin(), triangle_corners.end());
+    return true;
+}
+
+//------------------------------------------
+// rasterizing:
+
+void OcclusionBuffer::render(glm::mat4 const &clip_from_world_, glm::mat4 const *matrices, JobSystem *jobs)
+{
+    clip_from_world = clip_from_world_;
+    depth.resize(size_t(Width) * Height);
+    screen.resize(corners.size() / 3 * 2);
+
+    // place every triangle on the screen, clipped to the near plane (z >= 0, as in extract_planes), where
+    //  losing one corner leaves a quad (two triangles):
+    auto place = [&](size_t begin, size_t end)
+    {
+        for (size_t o = begin; o < end; ++o)
+        {
+            Occluder const &occluder = occluders[o];
+            glm::mat4 CLIP_FROM_LOCAL = clip_from_world * matrices[occluder.matrix];
+            for (uint32_t t = occluder.first; t < occluder.first + occluder.count; ++t)
+            {
+                ScreenTriangle *out = &screen[2 * size_t(t)];
+                out[0] = out[1] = ScreenTriangle{};
+
+                glm::vec4 clip[3];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    clip[k] = CLIP_FROM_LOCAL * glm::vec4(corners[3 * size_t(t) + k], 1.0f);
+                }
+                glm::vec4 polygon[4];
+                uint32_t corner_count = 0;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    glm::vec4 const &a = clip[k];
+                    glm::vec4 const &b = clip[(k + 1) % 3];
+                    if (a.z >= 0.0f)
+                        polygon[corner_count++] = a;
+                    if ((a.z >= 0.0f) != (b.z >= 0.0f))
+                        polygon[corner_count++] = a + (b - a) * (a.z / (a.z - b.z));
+                }
+                if (corner_count >= 3)
+                    setup(polygon, &out[0]);
+                if (corner_count == 4)
+                {
+                    glm::vec4 second[3] = {polygon[0], polygon[2], polygon[3]};
+                    setup(second, &out[1]);
+                }
+            }
+        }
+    };
+    if (jobs)
+        jobs->parallel_for(occluders.size(), 1, place);
+    else
+        place(0, occluders.size());
+
+    // then each band of rows clears itself and draws every triangle that reaches it (so no two jobs share a pixel):
+    uint32_t bands = (Height + BandHeight - 1) / BandHeight;
+    auto draw = [&](size_t begin, size_t end)
+    {
+        for (size_t band = begin; band < end; ++band)
+        {
+            int32_t row_begin = int32_t(band * BandHeight);
+            int32_t row_end = std::min(int32_t(Height), row_begin + int32_t(BandHeight));
+            std::fill(depth.begin() + size_t(row_begin) * Width, depth.begin() + size_t(row_end) * Width, 1.0f);
+            for (ScreenTriangle const &triangle : screen)
+            {
+                if (triangle.x_min > triangle.x_max || triangle.y_max < row_begin || triangle.y_min >= row_end)
+                    continue;
+                rasterize(triangle, row_begin, row_end);
+            }
+        }
+    };
+    if (jobs)
+        jobs->parallel_for(bands, 1, draw);
+    else
+        draw(0, bands);
+}
+
+void OcclusionBuffer::setup(glm::vec4 const clip[3], ScreenTriangle *out) const
+{
+    glm::vec3 p[3];
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        if (clip[k].w <= 0.0f)
+            return;
+        p[k] = to_pixels(clip[k]);
+    }
+    if (std::min({p[0].z, p[1].z, p[2].z}) > 1.0f)
+        return; // (beyond the far plane)
+
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    if (!(std::abs(area) > 1e-6f))
+        return; // (degenerate, or not a number)
+    if (area < 0.0f)
+    {
+        std::swap(p[1], p[2]);
+        area = -area;
+    }
+
+    float x_lo = std::min({p[0].x, p[1].x, p[2].x});
+    float x_hi = std::max({p[0].x, p[1].x, p[2].x});
+    float y_lo = std::min({p[0].y, p[1].y, p[2].y});
+    float y_hi = std::max({p[0].y, p[1].y, p[2].y});
+    if (x_hi < 0.0f || y_hi < 0.0f || x_lo >= float(Width) || y_lo >= float(Height))
+        return;
+
+    // edge k runs from corner k to corner k + 1, and measures area at corner k + 2 (so, divided by area,
+    //  it is that corner's barycentric weight, which makes the depth plane):
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        glm::vec3 const &a = p[k];
+        glm::vec3 const &b = p[(k + 1) % 3];
+        out->edges[k][0] = a.y - b.y;
+        out->edges[k][1] = b.x - a.x;
+        out->edges[k][2] = a.x * b.y - a.y * b.x;
+    }
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        out->depth[c] = 0.0f;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            out->depth[c] += out->edges[k][c] * (p[(k + 2) % 3].z / area);
+        }
+    }
+    // (written at the center, but as deep as the plane gets anywhere in the pixel, so depth is never too near)
+    out->depth[2] += 0.5f * (std::abs(out->depth[0]) + std::abs(out->depth[1]));
+
+    out->x_min = int32_t(std::max(x_lo, 0.0f));
+    out->x_max = int32_t(std::min(x_hi, float(Width - 1)));
+    out->y_min = int32_t(std::max(y_lo, 0.0f));
+    out->y_max = int32_t(std::min(y_hi, float(Height - 1)));
+}
+
+void OcclusionBuffer::rasterize(ScreenTriangle const &triangle, int32_t row_begin, int32_t row_end)
+{
+    int32_t y_begin = std::max(triangle.y_min, row_begin);
+    int32_t y_end = std::min(triangle.y_max + 1, row_end);
+    int32_t x_begin = triangle.x_min - triangle.x_min % int32_t(WideLanes); // (registers stay inside the row)
+
+    alignas(32) float offsets[WideLanes];
+    for (uint32_t l = 0; l < WideLanes; ++l)
+    {
+        offsets[l] = float(l) + 0.5f; // (pixel centers)
+    }
+    Wide const lane_x = load(offsets);
+    Wide const zero = splat(0.0f);
+    Wide const edge_x[3] = {splat(triangle.edges[0][0]), splat(triangle.edges[1][0]), splat(triangle.edges[2][0])};
+    Wide const depth_x = splat(triangle.depth[0]);
+
+    for (int32_t y = y_begin; y < y_end; ++y)
+    {
+        float center_y = float(y) + 0.5f;
+        Wide edge_row[3];
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            edge_row[k] = splat(triangle.edges[k][1] * center_y + triangle.edges[k][2]);
+        }
+        Wide depth_row = splat(triangle.depth[1] * center_y + triangle.depth[2]);
+
+        float *row = depth.data() + size_t(y) * Width;
+        for (int32_t x = x_begin; x <= triangle.x_max; x += int32_t(WideLanes))
+        {
+            Wide center_x = add(splat(float(x)), lane_x);
+            Wide outside = less(add(mul(edge_x[0], center_x), edge_row[0]), zero);
+            outside = bit_or(outside, less(add(mul(edge_x[1], center_x), edge_row[1]), zero));
+            outside = bit_or(outside, less(add(mul(edge_x[2], center_x), edge_row[2]), zero));
+            if (sign_bits(outside) == AllLanes)
+                continue;
+
+            // nearer depth in the covered lanes only:
+            Wide old = load(row + x);
+            Wide z = add(mul(depth_x, center_x), depth_row);
+            store(row + x, select(outside, old, min(old, z)));
+        }
+    }
+}
+
+//------------------------------------------
+// testing:
+
+bool OcclusionBuffer::occluded(BBox const &box) const
+{
+    if (depth.empty() || box.empty())
+        return false;
+
+    float x_lo = FLT_MAX, x_hi = -FLT_MAX;
+    float y_lo = FLT_MAX, y_hi = -FLT_MAX;
+    float nearest = FLT_MAX;
+    for (uint32_t c = 0; c < 8; ++c)
+    {
+        glm::vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = clip_from_world * glm::vec4(corner, 1.0f);
+        if (clip.z < 0.0f || clip.w <= 0.0f)
+            return false; // (crosses the near plane, so could cover anything)
+        glm::vec3 p = to_pixels(clip);
+        x_lo = std::min(x_lo, p.x);
+        x_hi = std::max(x_hi, p.x);
+        y_lo = std::min(y_lo, p.y);
+        y_hi = std::max(y_hi, p.y);
+        nearest = std::min(nearest, p.z);
+    }
+    if (x_hi < 0.0f || y_hi < 0.0f || x_lo >= float(Width) || y_lo >= float(Height))
+        return false; // (off screen: left to the frustum test)
+
+    // every pixel the box's rectangle touches, and one more on each side, must have an occluder nearer than the
+    //  box's nearest corner (coverage is sampled at pixel centers, so where an occluder's edge crosses a touched
+    //  pixel, the neighbouring center on the far side of that edge is uncovered):
+    int32_t x_begin = int32_t(std::max(x_lo - 1.0f, 0.0f));
+    int32_t x_end = int32_t(std::min(x_hi + 1.0f, float(Width - 1))) + 1;
+    int32_t y_begin = int32_t(std::max(y_lo - 1.0f, 0.0f));
+    int32_t y_end = int32_t(std::min(y_hi + 1.0f, float(Height - 1))) + 1;
+    Wide const box_depth = splat(nearest);
+    for (int32_t y = y_begin; y < y_end; ++y)
+    {
+        float const *row = depth.data() + size_t(y) * Width;
+        for (int32_t x = x_begin - x_begin % int32_t(WideLanes); x < x_end; x += int32_t(WideLanes))
+        {
+            uint32_t lanes = lane_bits(x_begin - x, x_end - x);
+            uint32_t hidden = sign_bits(less(load(row + x), box_depth));
+            if ((hidden & lanes) != lanes)
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "lib/bbox.h"
+
+#include <cstdint>
+#include <vector>
+
+struct JobSystem;
+
+// A small software depth buffer for occlusion culling on the CPU (`--culling occlusion`):
+//  a few occluders -- low-poly meshes with large bounds, picked at load time -- are rasterized every frame into
+//  Width x Height nearest depths, and boxes whose screen rectangle is behind those depths everywhere are dropped
+//  before they become draws. Rows are split into bands rasterized by separate jobs; along a row, a SIMD register's
+//  worth of pixels is covered and depth-tested at once, and only the covered lanes are written (a masked min).
+//  Lanes are 8 wide when built with AVX2, 4 wide with SSE2 (any x86-64), and 1 elsewhere (lib/Wide.hpp).
+//  Coverage is sampled at pixel centers, so tests look one pixel past a box's rectangle and occluder depth is
+//  stored as its farthest within the pixel: a box is only dropped if it is hidden (short of gaps narrower than a
+//  pixel between separate occluders).
+struct OcclusionBuffer
+{
+    static constexpr uint32_t Width = 256; // pixels (a multiple of the widest register)
+    static constexpr uint32_t Height = 144;
+    static constexpr uint32_t BandHeight = 16;            // rows per job
+    static constexpr uint32_t MaxOccluders = 64;          // occluders in all
+    static constexpr uint32_t MaxOccluderTriangles = 512; // meshes with more triangles are never occluders
+    static constexpr uint32_t TriangleBudget = 8192;      // occluder triangles in all
+
+    struct Occluder
+    {
+        uint32_t matrix = 0; // index of the occluder's matrix (WORLD_FROM_LOCAL)
+        uint32_t first = 0;  // its triangles are [first, first + count) (corners 3 * first, ...)
+        uint32_t count = 0;
+    };
+    std::vector<Occluder> occluders;
+    std::vector<glm::vec3> corners; // three per triangle, in the occluder's own space
+
+    bool empty() const { return occluders.empty(); }
+
+    // add an occluder with triangles 'triangle_corners' (three corners each), placed by matrix 'matrix';
+    //  returns false (and adds nothing) if that would go over MaxOccluders or TriangleBudget:
+    bool add_occluder(uint32_t matrix, std::vector<glm::vec3> const &triangle_corners);
+
+    // clear, then rasterize every occluder, placed by matrices[occluder.matrix], as seen through clip_from_world:
+    void render(glm::mat4 const &clip_from_world, glm::mat4 const *matrices, JobSystem *jobs = nullptr);
+
+    // true if world-space 'box' is in front of the near plane and behind the occluders at every pixel it covers
+    //  (as of the last render()):
+    bool occluded(BBox const &box) const;
+
+    // a triangle in pixel space, as edge functions and a depth plane (each a * x + b * y + c):
+    struct ScreenTriangle
+    {
+        float edges[3][3]; // >= 0 inside
+        float depth[3];
+        int32_t x_min = 0, x_max = -1; // covered pixels (none, if x_min > x_max)
+        int32_t y_min = 0, y_max = -1;
+    };
+
+    glm::mat4 clip_from_world = glm::mat4(1.0f); // (as of the last render())
+    std::vector<float> depth;                    // [y * Width + x] nearest occluder depth (1 where there is none)
+    std::vector<ScreenTriangle> screen;          // (scratch for render) two per occluder triangle (near clipping can split one)
+
+    void setup(glm::vec4 const clip[3], ScreenTriangle *out) const; // (for render; clip is in front of the near plane)
+    void rasterize(ScreenTriangle const &triangle, int32_t row_begin, int32_t row_end);
+};
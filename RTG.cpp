@@ -58,6 +58,76 @@ void RTG::Configuration::parse(int argc, char **argv)
 			{
 				cull_mode = FRUSTUM;
 			}
+			else if (std::string(argv[argi]) == "gpu")
+			{
+				cull_mode = GPU;
+			}
+			else if (std::string(argv[argi]) == "hiz")
+			{
+				cull_mode = HIZ;
+			}
+			else if (std::string(argv[argi]) == "occlusion")
+			{
+				cull_mode = OCCLUSION;
+			}
+		}
+		else if (arg == "--scene-cache")
+		{
+			scene_cache = true;
+		}
+		else if (arg == "--no-scene-cache")
+		{
+			scene_cache = false;
+		}
+		else if (arg == "--weld")
+		{
+			weld_vertices = true;
+		}
+		else if (arg == "--packed-vertices")
+		{
+			packed_vertices = true;
+		}
+		else if (arg == "--depth-prepass")
+		{
+			depth_prepass = true;
+		}
+		else if (arg == "--gpu-transforms")
+		{
+			gpu_transforms = true;
+		}
+		else if (arg == "--benchmark-animation")
+		{
+			benchmark_animation = true;
+		}
+		else if (arg == "--benchmark-culling")
+		{
+			benchmark_culling = true;
+		}
+		else if (arg == "--compress-animation")
+		{
+			compress_animation = true;
+		}
+		else if (arg == "--bake-animation")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--bake-animation requires a parameter (samples per second).");
+			argi += 1;
+			std::string val = argv[argi];
+			size_t used = 0;
+			try
+			{
+				bake_animation_rate = std::stof(val, &used);
+			}
+			catch (std::exception const &)
+			{
+				used = 0;
+			}
+			if (used != val.size() || !(bake_animation_rate > 0.0f))
+				throw std::runtime_error("--bake-animation should be a positive number, got '" + val + "'.");
+		}
+		else if (arg == "--bake-quantized")
+		{
+			bake_quantized = true;
 		}
 		else if (arg == "--headless")
 		{
@@ -93,11 +163,33 @@ void RTG::Configuration::parse(int argc, char **argv)
 			surface_extent.width = conv("width");
 			surface_extent.height = conv("height");
 		}
+		else if (arg == "--threads")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--threads requires a parameter (a thread count).");
+			argi += 1;
+			std::string val = argv[argi];
+			if (val.empty() || val.find_first_not_of("0123456789") != std::string::npos)
+				throw std::runtime_error("--threads should match [0-9]+, got '" + val + "'.");
+			threads = uint32_t(std::stoul(val));
+		}
 		else
 		{
 			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
 		}
 	}
+
+	// (GPU culling reads the world transforms that GPU propagation leaves in Scene_worlds)
+	if (gpu_culling())
+		gpu_transforms = true;
+
+	// (the depth pyramid is built from the swapchain's depth image)
+	if (cull_mode == HIZ && headless)
+		throw std::runtime_error("--culling hiz can't be combined with --headless.");
+
+	// (a bake replaces world transforms directly, but GPU propagation recomputes them from local transforms)
+	if (gpu_transforms && bake_animation_rate > 0.0f)
+		throw std::runtime_error("--gpu-transforms (or --culling gpu/hiz) can't be combined with --bake-animation.");
 }
 
 void RTG::Configuration::usage(std::function<void(const char *, const char *)> const &callback)
@@ -105,6 +197,18 @@ void RTG::Configuration::usage(std::function<void(const char *, const char *)> c
 	callback("--debug, --no-debug", "Turn on/off debug and validation layers.");
 	callback("--physical-device <name>", "Run on the named physical device (guesses, otherwise).");
 	callback("--drawing-size <w> <h>", "Set the size of the surface to draw to.");
+	callback("--culling <none|frustum|gpu|hiz|occlusion>", "Cull scene objects not at all, against the view frustum on the CPU, on the GPU with indirect draws, on the GPU with occlusion culling too, or on the CPU with occlusion culling too.");
+	callback("--scene-cache, --no-scene-cache", "Turn on/off loading and saving the <scene>.s72.cache file.");
+	callback("--weld", "Merge duplicate vertices of non-indexed meshes at load time and draw them indexed.");
+	callback("--packed-vertices", "Store scene vertex attributes compactly (octahedral normals, snorm tangents, fp16 texcoords).");
+	callback("--depth-prepass", "Draw scene depth with a position-only pipeline before shading.");
+	callback("--gpu-transforms", "Propagate scene transforms in a compute shader instead of writing per-instance transforms on the CPU.");
+	callback("--threads <n>", "Use n threads (including the main thread) for update work; 0 means one per hardware thread.");
+	callback("--benchmark-animation", "Compare batched (SIMD) and per-driver animation evaluation speed at load time.");
+	callback("--benchmark-culling", "Compare per-object, batched (SIMD), and tree frustum culling speed at load time.");
+	callback("--compress-animation", "Drop redundant animation keyframes and quantize the rest at load time.");
+	callback("--bake-animation <rate>", "Sample animated world transforms rate times per second at load time and play those back.");
+	callback("--bake-quantized", "Store baked animation transforms as 16-bit values.");
 }
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
@@ -134,7 +238,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 	return VK_FALSE;
 }
 
-RTG::RTG(Configuration const &configuration_) : helpers(*this)
+RTG::RTG(Configuration const &configuration_) : helpers(*this), jobs(configuration_.threads)
 {
 
 	// copy input configuration:
@@ -384,6 +488,13 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 						graphics_queue_family = i;
 				}
 
+				// if it does only transfers (usually a DMA engine), use it for uploads:
+				if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				{
+					if (!transfer_queue_family)
+						transfer_queue_family = i;
+				}
+
 				// if it has present support, set the present queue family:
 				VkBool32 present_support = VK_FALSE;
 				if (!this->configuration.headless)
@@ -409,6 +520,46 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 					throw std::runtime_error("No queue with present support.");
 				}
 			}
+
+			// no dedicated transfer queue? upload on the graphics queue:
+			if (!transfer_queue_family)
+			{
+				transfer_queue_family = graphics_queue_family;
+			}
+			if (configuration.debug)
+			{
+				std::cout << "Uploading on queue family " << transfer_queue_family.value() << (transfer_queue_family == graphics_queue_family ? " (graphics)" : " (transfer only)") << "." << std::endl;
+			}
+		}
+
+		// timeline semaphores (core in Vulkan 1.2) track upload batches; see Helpers::submit_uploads:
+		VkPhysicalDeviceVulkan12Features vulkan12_features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+			.timelineSemaphore = VK_TRUE,
+		};
+
+		// GPU culling draws each draw kind with one indirect call (multiDrawIndirect), using a GPU-written draw
+		//  count where the device has drawIndirectCount (core in Vulkan 1.2, but optional):
+		VkPhysicalDeviceFeatures device_features{};
+		if (configuration.gpu_culling())
+		{
+			VkPhysicalDeviceVulkan12Features supported12{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+			};
+			VkPhysicalDeviceFeatures2 supported{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				.pNext = &supported12,
+			};
+			vkGetPhysicalDeviceFeatures2(physical_device, &supported);
+			if (!supported.features.multiDrawIndirect)
+				throw std::runtime_error("GPU culling needs a device with multiDrawIndirect.");
+			device_features.multiDrawIndirect = VK_TRUE;
+			draw_indirect_count = (supported12.drawIndirectCount == VK_TRUE);
+			vulkan12_features.drawIndirectCount = supported12.drawIndirectCount;
+			if (configuration.debug)
+			{
+				std::cout << "GPU culling draws with " << (draw_indirect_count ? "vkCmdDrawIndirectCount" : "vkCmdDrawIndirect (no drawIndirectCount)") << "." << std::endl;
+			}
 		}
 
 		// select device extensions:
@@ -424,7 +575,8 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 			std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 			std::set<uint32_t> unique_queue_families{
 				graphics_queue_family.value(),
-				present_queue_family.value()};
+				present_queue_family.value(),
+				transfer_queue_family.value()};
 
 			float queue_priorities[1] = {1.0f};
 			for (uint32_t queue_family : unique_queue_families)
@@ -439,6 +591,7 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 
 			VkDeviceCreateInfo create_info{
 				.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+				.pNext = &vulkan12_features,
 				.queueCreateInfoCount = uint32_t(queue_create_infos.size()),
 				.pQueueCreateInfos = queue_create_infos.data(),
 
@@ -450,19 +603,20 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 				.ppEnabledExtensionNames = device_extensions.data(),
 
 				// pass a pointer to a VkPhysicalDeviceFeatures to request specific features: (e.g., thick lines)
-				.pEnabledFeatures = nullptr,
+				.pEnabledFeatures = &device_features,
 			};
 
 			VK(vkCreateDevice(physical_device, &create_info, nullptr, &device));
 
 			vkGetDeviceQueue(device, graphics_queue_family.value(), 0, &graphics_queue);
 			vkGetDeviceQueue(device, present_queue_family.value(), 0, &present_queue);
+			vkGetDeviceQueue(device, transfer_queue_family.value(), 0, &transfer_queue);
 		}
 		else
 		{
 			// in headless mode we just need graphic_queue
 			std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-			std::set<uint32_t> unique_queue_families{graphics_queue_family.value()};
+			std::set<uint32_t> unique_queue_families{graphics_queue_family.value(), transfer_queue_family.value()};
 
 			float queue_priorities = 0.f;
 			for (uint32_t queue_family : unique_queue_families)
@@ -478,6 +632,7 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 
 			VkDeviceCreateInfo create_info{
 				.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+				.pNext = &vulkan12_features,
 				.queueCreateInfoCount = uint32_t(queue_create_infos.size()),
 				.pQueueCreateInfos = queue_create_infos.data(),
 
@@ -489,12 +644,13 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 				.ppEnabledExtensionNames = device_extensions.data(),
 
 				// pass a pointer to a VkPhysicalDeviceFeatures to request specific features: (e.g., thick lines)
-				.pEnabledFeatures = nullptr,
+				.pEnabledFeatures = &device_features,
 			};
 
 			VK(vkCreateDevice(physical_device, &create_info, nullptr, &device));
 
 			vkGetDeviceQueue(device, graphics_queue_family.value(), 0, &graphics_queue);
+			vkGetDeviceQueue(device, transfer_queue_family.value(), 0, &transfer_queue);
 
 			std::cout << "vkGetDeviceQueue done!\n";
 		}
@@ -907,6 +1063,9 @@ void RTG::run(Application &application)
 				VK(vkResetFences(device, 1, &workspaces[workspace_index].workspace_available));
 			}
 
+			// free staging memory of any uploads that have finished:
+			helpers.retire_uploads();
+
 			uint32_t image_index = -1U;
 
 			if (!configuration.headless)
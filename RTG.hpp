@@ -1,6 +1,7 @@
 #pragma once
 
 #include "helper/Helpers.hpp"
+#include "helper/JobSystem.hpp"
 #include "controllers/InputEvent.hpp"
 #include "Scene.hpp"
 
@@ -64,7 +65,56 @@ struct RTG
 
 		std::string camera_name = "";
 
+		// how scene objects are culled (`gpu` and `hiz` also turn on gpu_transforms):
+		//  `--culling <none|frustum|gpu|hiz|occlusion>` command-line flag
 		Cull_Mode cull_mode = DEFAULT;
+		bool gpu_culling() const { return cull_mode == GPU || cull_mode == HIZ; } // (draws come from Tutorial::cull_pipeline)
+
+		// if true, load the scene from (and save it to) a cache file beside the .s72:
+		//  `--scene-cache` and `--no-scene-cache` command-line flags
+		bool scene_cache = true;
+
+		// if true, merge identical vertices of non-indexed meshes at load time and draw them indexed:
+		//  `--weld` command-line flag
+		bool weld_vertices = false;
+
+		// if true, store scene vertex attributes as PackedSceneAttributes (20 bytes) instead of SceneAttributes (40 bytes):
+		//  `--packed-vertices` command-line flag
+		bool packed_vertices = false;
+
+		// if true, lay down scene depth with the position-only pipeline before shading:
+		//  `--depth-prepass` command-line flag
+		bool depth_prepass = false;
+
+		// if true, compute scene world transforms (and each instance's Transform) on the GPU from uploaded local
+		//  transforms, instead of writing every instance's Transform on the CPU:
+		//  `--gpu-transforms` command-line flag
+		bool gpu_transforms = false;
+
+		// if true, time batched driver evaluation against Driver::make_animation after loading the scene:
+		//  `--benchmark-animation` command-line flag
+		bool benchmark_animation = false;
+
+		// if true, time per-object, batched (SIMD), and tree culling of the scene objects after loading the scene:
+		//  `--benchmark-culling` command-line flag
+		bool benchmark_culling = false;
+
+		// if true, drop redundant driver keyframes and quantize the rest at load time (see Driver::compress):
+		//  `--compress-animation` command-line flag
+		bool compress_animation = false;
+
+		// if nonzero, bake animated world transforms at this many samples per second and play those back instead
+		//  of evaluating drivers (saved as <scene>.s72.bake when the scene cache is on):
+		//  `--bake-animation <rate>` command-line flag
+		float bake_animation_rate = 0.0f;
+
+		// if true, store baked transforms as 16-bit values (about half the memory, slightly less precise):
+		//  `--bake-quantized` command-line flag
+		bool bake_quantized = false;
+
+		// threads used by the job system (counting the main thread; 0 means one per hardware thread):
+		//  `--threads <n>` command-line flag
+		uint32_t threads = 0;
 
 		// if true, set on headless mode:
 		bool headless = false;
@@ -97,6 +147,10 @@ struct RTG
 	// see Helpers.hpp
 	Helpers helpers;
 
+	// Thread pool for splitting CPU work (e.g., the application's update) across cores:
+	// see JobSystem.hpp
+	JobSystem jobs;
+
 	//------------------------------------------------
 	// Basic vulkan handles:
 
@@ -104,11 +158,16 @@ struct RTG
 	VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
+	bool draw_indirect_count = false; // device has (and was created with) drawIndirectCount; see configuration.cull_mode
 
 	// queue for graphics and transfer operations:
 	std::optional<uint32_t> graphics_queue_family;
 	VkQueue graphics_queue = VK_NULL_HANDLE;
 
+	// queue for uploads (a transfer-only family if the device has one; otherwise the same as graphics):
+	std::optional<uint32_t> transfer_queue_family;
+	VkQueue transfer_queue = VK_NULL_HANDLE;
+
 	// queue for present operations:
 	std::optional<uint32_t> present_queue_family;
 	VkQueue present_queue = VK_NULL_HANDLE;
@@ -1,4 +1,9 @@
 #include "Scene.hpp"
+#include "helper/JobSystem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
 
 // Define the global variable
 S72_scene s72_scene;
@@ -252,6 +257,7 @@ void get_scene(const std::vector<sejp::value> &array)
                 }
 
                 // Add the parsed mesh to the meshes vector
+                mesh.index_ = uint32_t(s72_scene.meshes.size());
                 s72_scene.meshes.push_back(mesh);
             }
 
@@ -346,32 +352,26 @@ void get_scene(const std::vector<sejp::value> &array)
                         // Check if the values array size is correct: timesArray.size() * channel_dim == valuesArray.size()
                         if (timesArray.size() * driver.channel_dim == valuesArray.size())
                         {
+                            driver.times.reserve(timesArray.size());
+                            driver.values.reserve(valuesArray.size());
                             for (size_t i = 0; i < timesArray.size(); ++i)
                             {
                                 if (!timesArray[i].as_number())
                                     continue;
 
-                                Driver::Frame frame;
-                                frame.time = static_cast<float>(timesArray[i].as_number().value());
-                                // std::cout << frame.time << ":  ";
+                                float time = static_cast<float>(timesArray[i].as_number().value());
+                                driver.times.push_back(time);
                                 //  Extract channel_dim values for each frame
                                 for (size_t j = 0; j < driver.channel_dim; ++j)
                                 {
-                                    if (valuesArray[i * driver.channel_dim + j].as_number())
-                                    {
-                                        frame.value.push_back(static_cast<float>(valuesArray[i * driver.channel_dim + j].as_number().value()));
-                                    }
-                                    // std::cout << frame.value[j] << ",";
+                                    auto value = valuesArray[i * driver.channel_dim + j].as_number();
+                                    driver.values.push_back(value ? static_cast<float>(value.value()) : 0.0f);
                                 }
 
-                                // std::cout << "    ";
-
-                                driver.frames.push_back(frame);
-
-                                if (frame.time > s72_scene.animation_duration)
+                                if (time > s72_scene.animation_duration)
                                 {
-                                    dt = frame.time - s72_scene.animation_duration;
-                                    s72_scene.animation_duration = frame.time;
+                                    dt = time - s72_scene.animation_duration;
+                                    s72_scene.animation_duration = time;
                                 }
                             }
                             // for the last frame interpolation in loop animation
@@ -405,43 +405,101 @@ void get_scene(const std::vector<sejp::value> &array)
         }
         index++;
     }
+
+    index_scene_names();
 }
 
-Mesh *find_mesh_by_name(const std::string &mesh_name)
+void SceneNames::clear()
 {
-    for (auto &mesh : s72_scene.meshes)
+    ids.clear();
+    node.clear();
+    mesh.clear();
+    camera.clear();
+}
+
+uint32_t SceneNames::intern(std::string const &name)
+{
+    auto [it, inserted] = ids.emplace(name, uint32_t(ids.size()));
+    if (inserted)
     {
-        if (mesh.name == mesh_name)
-        {
-            return &mesh; // Return a pointer to the matching mesh
-        }
+        node.emplace_back(-1);
+        mesh.emplace_back(-1);
+        camera.emplace_back(-1);
     }
-    return nullptr; // Return nullptr if mesh is not found
+    return it->second;
 }
 
-Camera *find_camera_by_name(const std::string &camera_name)
+int32_t SceneNames::find(std::string const &name) const
 {
-    for (auto &camera : s72_scene.cameras)
+    auto found = ids.find(name);
+    return found == ids.end() ? -1 : int32_t(found->second);
+}
+
+void index_scene_names()
+{
+    SceneNames &names = s72_scene.names;
+    names.clear();
+    names.ids.reserve(s72_scene.nodes.size() + s72_scene.meshes.size() + s72_scene.cameras.size());
+
+    // (only the first object of each kind with a given name is indexed)
+    for (size_t i = 0; i < s72_scene.nodes.size(); ++i)
+    {
+        int32_t &slot = names.node[names.intern(s72_scene.nodes[i].name)];
+        if (slot < 0)
+            slot = int32_t(i);
+    }
+    for (size_t i = 0; i < s72_scene.meshes.size(); ++i)
+    {
+        int32_t &slot = names.mesh[names.intern(s72_scene.meshes[i].name)];
+        if (slot < 0)
+            slot = int32_t(i);
+    }
+    for (size_t i = 0; i < s72_scene.cameras.size(); ++i)
+    {
+        int32_t &slot = names.camera[names.intern(s72_scene.cameras[i].name)];
+        if (slot < 0)
+            slot = int32_t(i);
+    }
+
+    // resolve children references once, so building the trees doesn't look names up per visit:
+    for (auto &node : s72_scene.nodes)
     {
-        if (camera.name == camera_name)
+        node.children_index_.clear();
+        node.children_index_.reserve(node.children.size());
+        for (auto const &child : node.children)
         {
-            return &camera; // Return a pointer to the matching camera
+            if (Node *child_node = find_node_by_name_or_index(child))
+            {
+                node.children_index_.emplace_back(uint32_t(child_node - s72_scene.nodes.data()));
+            }
         }
     }
-    return nullptr; // Return nullptr if camera is not found
+}
+
+Mesh *find_mesh_by_name(const std::string &mesh_name)
+{
+    int32_t id = s72_scene.names.find(mesh_name);
+    if (id < 0 || s72_scene.names.mesh[id] < 0)
+        return nullptr; // Return nullptr if mesh is not found
+    return &s72_scene.meshes[s72_scene.names.mesh[id]];
+}
+
+Camera *find_camera_by_name(const std::string &camera_name)
+{
+    int32_t id = s72_scene.names.find(camera_name);
+    if (id < 0 || s72_scene.names.camera[id] < 0)
+        return nullptr; // Return nullptr if camera is not found
+    return &s72_scene.cameras[s72_scene.names.camera[id]];
 }
 
 Node *find_node_by_name_or_index(const std::variant<std::string, double> &root)
 {
     if (std::holds_alternative<std::string>(root))
     {
-        const std::string &node_name = std::get<std::string>(root);
-        for (auto &node : s72_scene.nodes)
+        int32_t id = s72_scene.names.find(std::get<std::string>(root));
+        if (id >= 0 && s72_scene.names.node[id] >= 0)
         {
-            if (node.name == node_name)
-            {
-                return &node;
-            }
+            return &s72_scene.nodes[s72_scene.names.node[id]];
         }
     }
     else if (std::holds_alternative<double>(root))
@@ -494,19 +552,15 @@ void dfs_build_tree(Node *current_node, Node *parrent_node, std::vector<Node *>
     }
 
     // Process each child of the current node
-    for (const auto &child : current_node->children)
+    for (uint32_t child : current_node->children_index_)
     {
-        Node *child_node = find_node_by_name_or_index(child);
-
-        if (child_node)
-        {
-            current_node->children_node_.push_back(child_node);
-            // std::cout << " child: " << child_node->name << "  mesh: " << child_node->mesh_name << " to parent: " << current_node->name << "\n";
-            //   Recursively build the tree for the child
-            //  s72_scene.nodes_map.push_back(child_node); // Store in nodes_map
-            s72_scene.nodes_map[child_node->name] = child_node;
-            dfs_build_tree(child_node, current_node, current_path); // Continue DFS
-        }
+        Node *child_node = &s72_scene.nodes[child];
+        current_node->children_node_.push_back(child_node);
+        // std::cout << " child: " << child_node->name << "  mesh: " << child_node->mesh_name << " to parent: " << current_node->name << "\n";
+        //   Recursively build the tree for the child
+        //  s72_scene.nodes_map.push_back(child_node); // Store in nodes_map
+        s72_scene.nodes_map[child_node->name] = child_node;
+        dfs_build_tree(child_node, current_node, current_path); // Continue DFS
     }
     // std::cout << current_node->name << " children #:  " << current_node->children_node_.size() << "\n";
 
@@ -667,6 +721,7 @@ void make_user_camera()
 
     path.push_back(&node);
     s72_scene.cameras_path[node.camera_name] = path;
+    index_scene_names();
 
     // std::cout << "add user-camera done\n";
 }
@@ -688,132 +743,303 @@ glm::mat4 generate_transform(const Node *node)
     return WORLD_FROM_LOCAL;
 }
 
-void Driver::make_animation(float time)
+uint32_t Driver::find_keyframe(float time)
 {
-    if (s72_scene.nodes_map.find(this->refnode_name) == s72_scene.nodes_map.end())
-        return;
+    uint32_t count = uint32_t(times.size());
+    assert(count > 0);
 
-    Node *node_ = s72_scene.nodes_map[this->refnode_name];
+    // fast path: 'time' is still in the last segment, or has just moved on to the next one:
+    for (uint32_t k = cursor; k < count && k <= cursor + 1; ++k)
+    {
+        if (times[k] <= time && (k + 1 == count || time < times[k + 1]))
+        {
+            cursor = k;
+            return k;
+        }
+    }
 
-    uint32_t size = (uint32_t)(this->frames.size());
-    [[maybe_unused]] float min_time = this->frames[0].time,
-                           max_time = this->frames[size - 1].time,
-                           fraction;
+    // otherwise (seek, reverse playback, restart, first call), binary search:
+    auto after = std::upper_bound(times.begin(), times.end(), time);
+    cursor = (after == times.begin() ? 0 : uint32_t(after - times.begin()) - 1);
+    return cursor;
+}
 
-    if (time > max_time)
+float Driver::find_segment(float time, uint32_t *from, uint32_t *to)
+{
+    uint32_t count = uint32_t(times.size());
+    uint32_t current_frame = find_keyframe(time);
+    uint32_t next_frame = current_frame;
+    float fraction = 0.0f;
+    if (time < times[0])
     {
-        current_frame = size - 1;
-        next_frame = 0;
-        fraction = (time - max_time) / (s72_scene.animation_duration - max_time);
-        fraction = std::clamp(fraction, 0.f, 1.f);
+        // before the first keyframe: hold it
+    }
+    else if (current_frame + 1 < count)
+    {
+        next_frame = current_frame + 1;
+        fraction = (time - times[current_frame]) / (times[next_frame] - times[current_frame]);
     }
     else
     {
-        while (time > this->frames[next_frame].time)
-        {
-            next_frame++;
-            if (current_frame == size - 1) // a new loop
-            {
-                current_frame = 0;
-            }
-            else
-            {
-                current_frame++;
-            }
-        }
-        fraction = (time - frames[current_frame].time) / (frames[next_frame].time - frames[current_frame].time);
-        fraction = std::clamp(fraction, 0.f, 1.f);
+        // past the last keyframe: blend back toward the first one, so looping playback is seamless
+        next_frame = 0;
+        float span = s72_scene.animation_duration - times[current_frame];
+        fraction = (span > 0.0f ? (time - times[current_frame]) / span : 0.0f);
     }
+    *from = current_frame;
+    *to = next_frame;
+    return std::clamp(fraction, 0.f, 1.f);
+}
 
-    // calculate interpolation matrix
-    if (this->channel_dim == 3)
-    {
-        auto start = glm::vec3(frames[current_frame].value[0],
-                               frames[current_frame].value[1],
-                               frames[current_frame].value[2]);
+void Driver::make_animation(float time)
+{
+    if (node_index < 0 || times.empty() || (channel_dim != 3 && channel_dim != 4))
+        return;
+    NodeTRS &local = s72_scene.hierarchy.local[node_index];
+    s72_scene.hierarchy.mark_dirty(node_index); // (however many channels animate this node, its subtree is updated once)
 
-        auto end = glm::vec3(frames[next_frame].value[0],
-                             frames[next_frame].value[1],
-                             frames[next_frame].value[2]);
+    // pick the two keyframes to blend between:
+    uint32_t current_frame, next_frame;
+    float fraction = find_segment(time, &current_frame, &next_frame);
 
-        if (interpolation == STEP)
+    float start[4], end[4], value[4];
+    key_value(current_frame, start);
+    key_value(next_frame, end);
+    blend(start, end, fraction, value);
+
+    if (channel_dim == 3)
+    {
+        if (channel == TRANSLATION)
         {
-            if (channel == TRANSLATION)
-            {
-                node_->position = start;
-                // auto result = glm::translate(glm::mat4(1.0f), start);
-                return;
-            }
-            else if (channel == SCALE)
-            {
-                node_->scale = start;
-                return;
-            }
+            local.position = glm::vec3(value[0], value[1], value[2]);
         }
-        else
+        else if (channel == SCALE)
         {
-            auto vec3_interpolation = glm::mix(start, end, fraction);
+            local.scale = glm::vec3(value[0], value[1], value[2]);
+        }
+    }
+    else if (channel_dim == 4)
+    {
+        // (values are stored xyzw; glm::quat takes wxyz)
+        local.rotation = glm::quat(value[3], value[0], value[1], value[2]);
+    }
+}
 
-            if (channel == TRANSLATION)
-            {
-                node_->position = vec3_interpolation;
-                // return glm::translate(glm::mat4(1.0f), vec3_interpolation);
-                return;
-            }
-            else if (channel == SCALE)
-            {
-                node_->scale = vec3_interpolation;
-                // return glm::scale(glm::mat4(1.0f), vec3_interpolation);
-                return;
-            }
+void Driver::blend(float const *from, float const *to, float fraction, float *out) const
+{
+    if (channel_dim == 3)
+    {
+        glm::vec3 value = glm::vec3(from[0], from[1], from[2]);
+        if (interpolation != STEP)
+        {
+            value = glm::mix(value, glm::vec3(to[0], to[1], to[2]), fraction);
         }
+        out[0] = value.x, out[1] = value.y, out[2] = value.z;
     }
     else if (channel_dim == 4)
     {
-        auto start = glm::quat(frames[current_frame].value[3],
-                               frames[current_frame].value[0],
-                               frames[current_frame].value[1],
-                               frames[current_frame].value[2]);
+        glm::quat value = glm::quat(from[3], from[0], from[1], from[2]);
+        if (interpolation == SLERP)
+        {
+            value = glm::slerp(value, glm::quat(to[3], to[0], to[1], to[2]), fraction);
+        }
+        else if (interpolation == LINEAR)
+        {
+            value = glm::mix(value, glm::quat(to[3], to[0], to[1], to[2]), fraction);
+        }
+        out[0] = value.x, out[1] = value.y, out[2] = value.z, out[3] = value.w;
+    }
+}
 
-        auto end = glm::quat(frames[next_frame].value[3],
-                             frames[next_frame].value[0],
-                             frames[next_frame].value[1],
-                             frames[next_frame].value[2]);
+namespace
+{
+    // components of a unit quaternion other than the largest are within +-1/sqrt(2):
+    constexpr float SmallestThreeRange = 0.70710678f;
+    constexpr float SmallestThreeSteps = 32767.0f; // (15 bits)
 
-        if (interpolation == SLERP)
+    void encode_rotation(float const *xyzw, uint16_t *out)
+    {
+        glm::vec4 q(xyzw[0], xyzw[1], xyzw[2], xyzw[3]);
+        float length = glm::length(q);
+        q = (length > 0.0f ? q / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+        uint32_t largest = 0;
+        for (uint32_t c = 1; c < 4; ++c)
         {
-            glm::quat quat_interpolation = glm::slerp(start, end, fraction);
-            node_->rotation = quat_interpolation;
-            return; // glm::mat4_cast(quat_interpolation);
+            if (std::abs(q[c]) > std::abs(q[largest]))
+                largest = c;
         }
-        else
+
+        for (uint32_t c = 0, o = 0; c < 4; ++c)
         {
-            glm::quat quat_interpolation = glm::mix(start, end, fraction);
-            node_->rotation = quat_interpolation;
-            return; // glm::mat4_cast(quat_interpolation);
+            if (c == largest)
+                continue;
+            float unit = std::clamp(q[c] / SmallestThreeRange * 0.5f + 0.5f, 0.0f, 1.0f);
+            out[o++] = uint16_t(std::round(unit * SmallestThreeSteps));
+        }
+        // (the sign is kept, rather than flipping q so the largest is positive, because LINEAR rotations (glm::mix) take no
+        //  shortest path, so q and -q blend differently)
+        out[0] |= uint16_t((largest & 1) << 15);
+        out[1] |= uint16_t((largest >> 1) << 15);
+        out[2] |= uint16_t((q[largest] < 0.0f ? 1 : 0) << 15);
+    }
+
+    void decode_rotation(uint16_t const *in, float *xyzw)
+    {
+        uint32_t largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        float rest[3];
+        float sum = 0.0f;
+        for (uint32_t o = 0; o < 3; ++o)
+        {
+            rest[o] = (float(in[o] & 0x7fff) / SmallestThreeSteps * 2.0f - 1.0f) * SmallestThreeRange;
+            sum += rest[o] * rest[o];
+        }
+        float big = std::sqrt(std::max(0.0f, 1.0f - sum));
+        for (uint32_t c = 0, o = 0; c < 4; ++c)
+        {
+            xyzw[c] = (c == largest ? ((in[2] >> 15) ? -big : big) : rest[o++]);
         }
     }
 }
 
-void Node::child_forward_kinematics_transforms(Node *node_)
+void Driver::key_value(uint32_t key, float *out) const
 {
-    if (node_ == nullptr)
+    if (!compressed)
     {
+        std::copy_n(&values[size_t(key) * channel_dim], channel_dim, out);
+    }
+    else if (channel_dim == 4)
+    {
+        decode_rotation(&packed[size_t(key) * 3], out);
+    }
+    else
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            out[c] = range_min[c] + float(packed[size_t(key) * 3 + c]) * range_scale[c];
+        }
+    }
+}
+
+size_t Driver::keyframe_bytes() const
+{
+    return times.size() * sizeof(float) + values.size() * sizeof(float) + packed.size() * sizeof(uint16_t);
+}
+
+void Driver::compress(float tolerance)
+{
+    uint32_t count = uint32_t(times.size());
+    uint32_t dim = channel_dim;
+    if (compressed || count == 0 || (dim != 3 && dim != 4) || values.size() != size_t(count) * dim)
         return;
+
+    // quantize every keyframe first (when that alone stays within tolerance), so the keyframe check below
+    //  measures what playback will actually produce:
+    packed.resize(size_t(count) * 3);
+    if (dim == 4)
+    {
+        compressed = (SmallestThreeRange / SmallestThreeSteps <= tolerance); // (half a step each way, on up to two components)
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            encode_rotation(&values[size_t(k) * 4], &packed[size_t(k) * 3]);
+        }
     }
+    else
+    {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+        glm::vec3 max = -min;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            glm::vec3 v(values[k * 3 + 0], values[k * 3 + 1], values[k * 3 + 2]);
+            min = glm::min(min, v);
+            max = glm::max(max, v);
+        }
+        range_min = min;
+        range_scale = (max - min) / 65535.0f;
+        compressed = (std::max({range_scale.x, range_scale.y, range_scale.z}) * 0.5f <= tolerance);
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                float steps = (range_scale[c] > 0.0f ? (values[k * 3 + c] - min[c]) / range_scale[c] : 0.0f);
+                packed[size_t(k) * 3 + c] = uint16_t(std::clamp(std::round(steps), 0.0f, 65535.0f));
+            }
+        }
+    }
+    if (!compressed)
+    {
+        packed.clear();
+    }
+
+    // can keyframes a and b stand in for every keyframe between them?
+    auto bridges = [&](uint32_t a, uint32_t b)
+    {
+        float va[4], vb[4], v[4];
+        key_value(a, va);
+        key_value(b, vb);
+        for (uint32_t k = a + 1; k < b; ++k)
+        {
+            float span = times[b] - times[a];
+            blend(va, vb, (span > 0.0f ? (times[k] - times[a]) / span : 0.0f), v); // (as playback will)
+            for (uint32_t c = 0; c < dim; ++c)
+            {
+                if (!(std::abs(v[c] - values[size_t(k) * dim + c]) <= tolerance))
+                    return false;
+            }
+        }
+        return true;
+    };
 
-    for (const auto &child_ : node_->children_node_)
+    // greedily stretch each kept keyframe's segment as far as it bridges (the first and last are always kept,
+    //  so playback before the first keyframe and the wrap from the last one are unchanged):
+    std::vector<uint32_t> kept{0};
+    for (uint32_t k = 2; k < count; ++k)
+    {
+        if (!bridges(kept.back(), k))
+            kept.emplace_back(k - 1);
+    }
+    if (count > 1)
+        kept.emplace_back(count - 1);
+
+    std::vector<float> kept_times;
+    std::vector<float> kept_values;
+    std::vector<uint16_t> kept_packed;
+    kept_times.reserve(kept.size());
+    for (uint32_t k : kept)
     {
-        s72_scene.transforms[child_] = glm::mat4(child_->make_local_to_world());
-        child_forward_kinematics_transforms(child_);
+        kept_times.emplace_back(times[k]);
+        if (compressed)
+            kept_packed.insert(kept_packed.end(), &packed[size_t(k) * 3], &packed[size_t(k) * 3] + 3);
+        else
+            kept_values.insert(kept_values.end(), &values[size_t(k) * dim], &values[size_t(k) * dim] + dim);
     }
+    times = std::move(kept_times);
+    values = std::move(kept_values);
+    packed = std::move(kept_packed);
+    cursor = 0;
+}
+
+void compress_drivers(float tolerance)
+{
+    size_t keys_before = 0, keys_after = 0;
+    size_t bytes_before = 0, bytes_after = 0;
+    for (Driver &driver : s72_scene.drivers)
+    {
+        keys_before += driver.times.size();
+        bytes_before += driver.keyframe_bytes();
+        driver.compress(tolerance);
+        keys_after += driver.times.size();
+        bytes_after += driver.keyframe_bytes();
+    }
+    std::cout << "Compressed animation: " << keys_before << " -> " << keys_after << " keyframes, "
+              << bytes_before << " -> " << bytes_after << " bytes.\n";
 }
 
 //--------------------------------------
 // the code below is from 15466 base code
 // https://github.com/15-466/15-466-f24-base2
 //--------------------------------------
-glm::mat4x3 Node::make_local_to_parent() const
+glm::mat4x3 NodeTRS::make_local_to_parent() const
 {
     // compute:
     //    translate   *   rotate    *   scale
@@ -830,7 +1056,7 @@ glm::mat4x3 Node::make_local_to_parent() const
         position);
 }
 
-glm::mat4x3 Node::make_parent_to_local() const
+glm::mat4x3 NodeTRS::make_parent_to_local() const
 {
     // compute:
     //    1/scale       *    rot^-1   *  translate^-1
@@ -859,6 +1085,16 @@ glm::mat4x3 Node::make_parent_to_local() const
         inv_rot * -position);
 }
 
+glm::mat4x3 Node::make_local_to_parent() const
+{
+    return NodeTRS{.position = position, .rotation = rotation, .scale = scale}.make_local_to_parent();
+}
+
+glm::mat4x3 Node::make_parent_to_local() const
+{
+    return NodeTRS{.position = position, .rotation = rotation, .scale = scale}.make_parent_to_local();
+}
+
 glm::mat4x3 Node::make_local_to_world() const
 {
     if (!parent_)
@@ -882,6 +1118,194 @@ glm::mat4x3 Node::make_world_to_local() const
     }
 }
 
+//--------------------------------------
+
+void NodeHierarchy::clear()
+{
+    nodes.clear();
+    parents.clear();
+    subtree_end.clear();
+    local.clear();
+    world.clear();
+    dirty.clear();
+    dirty_nodes.clear();
+}
+
+void NodeHierarchy::mark_dirty(int32_t index)
+{
+    assert(index >= 0 && size_t(index) < dirty.size());
+    if (!dirty[index])
+    {
+        dirty[index] = 1;
+        dirty_nodes.emplace_back(uint32_t(index));
+    }
+}
+
+void NodeHierarchy::update_range(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        glm::mat4 local_to_parent = glm::mat4(local[i].make_local_to_parent()); // note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+        int32_t parent = parents[i];
+        world[i] = (parent < 0 ? local_to_parent : world[parent] * local_to_parent);
+    }
+}
+
+void NodeHierarchy::update_world(JobSystem *jobs)
+{
+    assert(parents.size() == local.size() && world.size() == local.size());
+
+    // in index order, so a subtree that contains other dirty nodes is computed first and covers them:
+    std::sort(dirty_nodes.begin(), dirty_nodes.end());
+
+    update_roots.clear();
+    uint32_t covered = 0; // everything below this index is already up to date
+    for (uint32_t begin : dirty_nodes)
+    {
+        dirty[begin] = 0;
+        if (begin < covered)
+            continue;
+        update_roots.emplace_back(begin);
+        covered = subtree_end[begin];
+    }
+    dirty_nodes.clear();
+
+    if (jobs == nullptr || jobs->thread_count() == 1)
+    {
+        // (parents precede children within each subtree; the parent of its root is outside it and up to date)
+        for (uint32_t root : update_roots)
+        {
+            update_range(root, subtree_end[root]);
+        }
+        return;
+    }
+
+    // cut the subtrees into independent pieces of about ParallelGrain nodes: a big subtree's root is computed
+    //  here, and its children's subtrees (contiguous, one after another) are grouped into pieces or split further:
+    update_pieces.clear();
+    for (size_t r = 0; r < update_roots.size(); ++r) // (update_roots grows as subtrees are split)
+    {
+        uint32_t root = update_roots[r];
+        if (subtree_end[root] - root <= ParallelGrain)
+        {
+            update_pieces.emplace_back(root, subtree_end[root]);
+            continue;
+        }
+
+        update_range(root, root + 1);
+        uint32_t run = root + 1; // start of the current group of small sibling subtrees
+        for (uint32_t child = root + 1; child < subtree_end[root]; child = subtree_end[child])
+        {
+            if (subtree_end[child] - child > ParallelGrain)
+            {
+                if (run < child)
+                    update_pieces.emplace_back(run, child);
+                update_roots.emplace_back(child);
+                run = subtree_end[child];
+            }
+            else if (subtree_end[child] - run >= ParallelGrain)
+            {
+                update_pieces.emplace_back(run, subtree_end[child]);
+                run = subtree_end[child];
+            }
+        }
+        if (run < subtree_end[root])
+            update_pieces.emplace_back(run, subtree_end[root]);
+    }
+
+    jobs->parallel_for(update_pieces.size(), 0, [this](size_t begin, size_t end)
+                       {
+                           for (size_t p = begin; p < end; ++p)
+                           {
+                               update_range(update_pieces[p].first, update_pieces[p].second);
+                           } });
+}
+
+glm::mat4 NodeHierarchy::world_to_local(int32_t index) const
+{
+    assert(index >= 0 && size_t(index) < world.size());
+    return glm::inverse(world[index]);
+}
+
+void build_node_hierarchy()
+{
+    NodeHierarchy &hierarchy = s72_scene.hierarchy;
+    hierarchy.clear();
+
+    for (Node &node : s72_scene.nodes)
+    {
+        node.index_ = -1;
+    }
+
+    // depth-first (pre-order) from each root; a node reachable along several paths is placed under its
+    //  parent_ (the parent dfs_build_tree settled on), so it gets exactly one slot, after that parent.
+    //  (children_node_ can list a child more than once, so index_ is set to Queued when a node is pushed)
+    constexpr int32_t Queued = -2;
+    std::vector<std::pair<Node *, int32_t>> stack; // (node, parent index)
+    for (auto &root : s72_scene.scene.roots)
+    {
+        Node *root_node = find_node_by_name_or_index(root);
+        if (root_node == nullptr || root_node->index_ != -1 || root_node->parent_ != nullptr)
+            continue;
+        root_node->index_ = Queued;
+        stack.emplace_back(root_node, -1);
+        while (!stack.empty())
+        {
+            auto [node, parent] = stack.back();
+            stack.pop_back();
+
+            node->index_ = int32_t(hierarchy.nodes.size());
+            hierarchy.nodes.emplace_back(node);
+            hierarchy.parents.emplace_back(parent);
+            hierarchy.local.emplace_back(NodeTRS{.position = node->position, .rotation = node->rotation, .scale = node->scale});
+
+            // (pushed in reverse, so children are placed in order)
+            for (auto child = node->children_node_.rbegin(); child != node->children_node_.rend(); ++child)
+            {
+                if ((*child)->parent_ == node && (*child)->index_ == -1)
+                {
+                    (*child)->index_ = Queued;
+                    stack.emplace_back(*child, node->index_);
+                }
+            }
+        }
+    }
+
+    size_t count = hierarchy.nodes.size();
+
+    // subtrees are contiguous, so each one ends where the last of its children's subtrees does:
+    hierarchy.subtree_end.resize(count);
+    for (size_t i = count; i-- > 0;)
+    {
+        hierarchy.subtree_end[i] = std::max<uint32_t>(hierarchy.subtree_end[i], uint32_t(i + 1));
+        if (int32_t parent = hierarchy.parents[i]; parent >= 0)
+        {
+            hierarchy.subtree_end[parent] = std::max(hierarchy.subtree_end[parent], hierarchy.subtree_end[i]);
+        }
+    }
+
+    hierarchy.world.assign(count, glm::mat4(1.0f));
+    hierarchy.dirty.assign(count, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (hierarchy.parents[i] < 0)
+        {
+            hierarchy.mark_dirty(int32_t(i));
+        }
+    }
+    hierarchy.update_world();
+
+    // resolve each driver's target once, so per-frame evaluation does no name lookups; drivers are kept
+    //  sorted by target, so evaluating them walks hierarchy.local in order:
+    for (auto &driver : s72_scene.drivers)
+    {
+        auto found = s72_scene.nodes_map.find(driver.refnode_name);
+        driver.node_index = (found != s72_scene.nodes_map.end() && found->second != nullptr ? found->second->index_ : -1);
+    }
+    std::stable_sort(s72_scene.drivers.begin(), s72_scene.drivers.end(), [](Driver const &a, Driver const &b)
+                     { return a.node_index < b.node_index; });
+}
+
 glm::mat4 Camera::make_projection() const
 {
     return glm::perspective(perspective.vfov, perspective.aspect, perspective.near, perspective.far);
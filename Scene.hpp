@@ -20,6 +20,7 @@
 struct Mesh;
 struct Camera;
 struct Driver;
+struct JobSystem;
 
 enum Animation_Mode
 {
@@ -39,6 +40,9 @@ enum Cull_Mode
     DEFAULT,
     NONE,
     FRUSTUM,
+    GPU, // frustum culling and draw generation in a compute pass (implies gpu_transforms)
+    HIZ, // GPU culling, plus occlusion culling against a depth pyramid of last frame's visible objects
+    OCCLUSION, // frustum culling, plus occlusion culling against a few occluders rasterized on the CPU
 };
 
 enum DriverChannleType
@@ -71,8 +75,13 @@ enum MaterialType
 
 struct MsehVertices
 {
-    uint32_t first = 0;
-    uint32_t count = 0;
+    uint32_t first = 0; // first vertex (also the vertexOffset of indexed draws)
+    uint32_t count = 0; // number of vertices
+
+    // indexed meshes only (index_count == 0 means draw non-indexed):
+    uint32_t index_count = 0;
+    VkDeviceSize index_offset = 0; // byte offset into the scene index buffer (4-byte aligned)
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
 };
 
 struct Scene
@@ -81,6 +90,17 @@ struct Scene
     std::vector<std::variant<std::string, double>> roots; // roots can be either string or number
 };
 
+// a node's transform relative to its parent:
+struct NodeTRS
+{
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // n.b. wxyz init order
+    glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+
+    glm::mat4x3 make_local_to_parent() const;
+    glm::mat4x3 make_parent_to_local() const;
+};
+
 struct Node
 {
     std::string name;
@@ -91,6 +111,7 @@ struct Node
     glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
 
     std::vector<std::variant<std::string, double>> children;
+    std::vector<uint32_t> children_index_; // children resolved to positions in s72_scene.nodes (by index_scene_names)
     std::vector<Node *> children_node_;
 
     std::string mesh_name;
@@ -99,6 +120,7 @@ struct Node
     std::string light_name;
 
     Node *parent_ = nullptr;
+    int32_t index_ = -1; // position in s72_scene.hierarchy (-1 if not reachable from the scene roots)
 
     Mesh *mesh_ = nullptr;
     Camera *camera_ = nullptr;
@@ -109,11 +131,39 @@ struct Node
     // ..relative to its parent:
     glm::mat4x3 make_local_to_parent() const;
     glm::mat4x3 make_parent_to_local() const;
-    // ..relative to the world:
+    // ..relative to the world: (walks up parent_; per-frame code uses s72_scene.hierarchy instead)
     glm::mat4x3 make_local_to_world() const;
     glm::mat4x3 make_world_to_local() const;
+};
 
-    void child_forward_kinematics_transforms(Node *node_);
+// The node trees flattened into arrays in depth-first pre-order (every parent precedes its children, and
+//  each subtree is the contiguous range [i, subtree_end[i])), so world transforms are computed with linear
+//  passes instead of a walk up parent_ per node.
+//  local starts out as each Node's position/rotation/scale and is what drivers and camera controls animate;
+//  whoever changes local[i] calls mark_dirty(i), and update_world() then recomputes only the dirty subtrees.
+struct NodeHierarchy
+{
+    std::vector<Node *> nodes;          // node at each index (Node::index_ maps back)
+    std::vector<int32_t> parents;       // index of the parent (always less than the node's own index), -1 for roots
+    std::vector<uint32_t> subtree_end;  // one past the last descendant of each node
+    std::vector<NodeTRS> local;         // local transform of each node
+    std::vector<glm::mat4> world;       // WORLD_FROM_LOCAL of each node, as of the last update_world()
+
+    std::vector<uint8_t> dirty;         // dirty[i] != 0 => local[i] changed since the last update_world()
+    std::vector<uint32_t> dirty_nodes;  // indices with dirty set (unordered, no duplicates)
+
+    void clear();
+    void mark_dirty(int32_t index);
+    // bring world[] up to date for every dirty node and its descendants (each subtree computed once);
+    //  with a job system, large subtrees are split at their children and the pieces computed in parallel:
+    void update_world(JobSystem *jobs = nullptr);
+    void update_range(uint32_t begin, uint32_t end); // recompute world[begin, end) (the parent of each node is up to date or earlier in the range)
+
+    static constexpr uint32_t ParallelGrain = 1024; // nodes per parallel piece (roughly)
+    std::vector<uint32_t> update_roots;                             // (scratch) dirty subtrees to recompute (after update_world, the ones it did)
+    std::vector<std::pair<uint32_t, uint32_t>> update_pieces;       // (scratch) [begin, end) ranges computed in parallel
+    // LOCAL_FROM_WORLD of one node (from its current world matrix):
+    glm::mat4 world_to_local(int32_t index) const;
 };
 
 struct Mesh
@@ -141,6 +191,8 @@ struct Mesh
     std::map<std::string, Attribute> attributes; // Map to hold named attributes (POSITION, NORMAL, etc.)
 
     std::string material;
+
+    uint32_t index_ = 0; // position in s72_scene.meshes (and in mesh_vertices / mesh_bboxes)
 };
 
 struct Camera
@@ -157,28 +209,48 @@ struct Driver
 {
     std::string name;
     std::string refnode_name; // target object
+    int32_t node_index = -1;  // target's index in s72_scene.hierarchy (set by build_node_hierarchy; -1 if not placed)
     DriverChannleType channel;
     uint32_t channel_dim;
 
-    struct Frame
-    {
-        float time;
-        std::vector<float> value;
-    };
+    // keyframes, structure-of-arrays: times[k] (ascending) and values[k * channel_dim + 0 .. channel_dim - 1]
+    //  (rotations stored xyzw, as in the .s72 file):
+    std::vector<float> times;
+    std::vector<float> values;
+
+    // compressed keyframes (after compress(); values is then empty), three uint16 per keyframe:
+    //  rotations are "smallest three" quaternions: the other three components (in xyzw order, skipping the largest)
+    //  as 15 bits each over [-1/sqrt(2), 1/sqrt(2)], with the largest's index in the top bits of packed[0] and packed[1]
+    //  and its sign in the top bit of packed[2]; translation and scale are range_min + packed * range_scale per component.
+    bool compressed = false;
+    std::vector<uint16_t> packed;
+    glm::vec3 range_min = glm::vec3(0.0f);
+    glm::vec3 range_scale = glm::vec3(0.0f);
 
-    std::vector<Frame> frames;
+    static constexpr float CompressionTolerance = 1e-4f; // largest change compress() may make to a keyframe (per component)
+
+    // drop keyframes that interpolating their neighbours reproduces to within 'tolerance', then quantize the rest:
+    void compress(float tolerance = CompressionTolerance);
+    // channel_dim floats of keyframe 'key' (decoded, if compressed):
+    void key_value(uint32_t key, float *out) const;
+    size_t keyframe_bytes() const; // memory used by times and values (or packed)
 
     DriverInterpolation interpolation = DriverInterpolation::LINEAR;
 
-    // for animation use
-    uint32_t current_frame = 0;
-    uint32_t next_frame = 0;
+    // for animation use: keyframe found by the last lookup (so steady playback skips the search)
+    uint32_t cursor = 0;
+    uint32_t find_keyframe(float time); // last keyframe with times[k] <= time (0 if time is before all of them)
+    // keyframes to blend at 'time' (wrapping from the last back to the first) and the fraction of the way from *from to *to:
+    float find_segment(float time, uint32_t *from, uint32_t *to);
 
     glm::vec3 position_init = glm::vec3(0.0f, 0.0f, 0.0f);
     glm::vec3 scale_init = glm::vec3(1.0f, 1.0f, 1.0f);
     glm::quat rotation_init = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // n.b. wxyz init order
 
+    // evaluate this one driver into s72_scene.hierarchy (DriverBatch evaluates all of them at once, the same way):
     void make_animation(float time);
+    // channel_dim floats 'fraction' of the way from keyframe values 'from' to 'to', with this driver's interpolation:
+    void blend(float const *from, float const *to, float fraction, float *out) const;
 };
 
 // struct MaterialObject
@@ -204,16 +276,31 @@ struct Driver
 //     uint32_t shadow;
 // };
 
+// Every distinct name in the scene interned once to a dense id, with the node / mesh / camera carrying it
+//  (as a position in s72_scene.nodes / meshes / cameras, -1 if none; the first one wins, as a linear scan would).
+//  Built by index_scene_names, so name lookups while building the scene are one hash instead of a scan.
+struct SceneNames
+{
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<int32_t> node, mesh, camera; // by id
+
+    void clear();
+    uint32_t intern(std::string const &name); // id of name (added, with no objects, if new)
+    int32_t find(std::string const &name) const; // id of name, or -1 if it was never interned
+};
+
 struct S72_scene
 {
     struct Scene scene;
     float animation_duration = 0.f;
     // std::vector<Node *> roots;
     std::unordered_map<std::string, Node *> nodes_map;
+    SceneNames names;
     std::unordered_map<std::string, std::vector<Node *>> cameras_path;
-    std::unordered_map<Node *, glm::mat4> transforms;
-    std::unordered_map<Mesh *, MsehVertices> mesh_vertices_map;
-    std::unordered_map<Mesh *, BBox> mesh_bbox_map;
+    NodeHierarchy hierarchy;
+    // per-mesh data computed while loading vertices, indexed by Mesh::index_:
+    std::vector<MsehVertices> mesh_vertices;
+    std::vector<BBox> mesh_bboxes;
     std::vector<Node> nodes;
     std::vector<Mesh> meshes;
     std::vector<Camera> cameras;
@@ -226,9 +313,12 @@ void get_scene(const std::vector<sejp::value> &array);
 Mesh *find_mesh_by_name(const std::string &mesh_name);
 Camera *find_camera_by_name(const std::string &camera_name);
 Node *find_node_by_name_or_index(const std::variant<std::string, double> &root);
+void index_scene_names(); // (re)build s72_scene.names and every Node::children_index_ (after nodes/meshes/cameras change)
 void dfs_build_tree(Node *current_node, Node *parrent_node, std::vector<Node *> &);
 void build_node_trees();
+void build_node_hierarchy(); // (re)flatten the node trees into s72_scene.hierarchy, compute world transforms, and bind drivers to node indices
 void bind_driver();
+void compress_drivers(float tolerance = Driver::CompressionTolerance); // Driver::compress every driver, and report the savings
 void make_user_camera();
 
 // set up all the info from s72 file
@@ -0,0 +1,356 @@
+#include "SceneBVH.hpp"
+
+#include "helper/JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+
+namespace
+{
+    constexpr uint32_t AllPlanes = (1u << 6) - 1;
+
+    // the box's corner farthest along the plane's normal is behind it:
+    inline bool outside(BBox const &box, Plane const &plane)
+    {
+        glm::vec3 far_corner(plane.normal.x > 0 ? box.max.x : box.min.x,
+                             plane.normal.y > 0 ? box.max.y : box.min.y,
+                             plane.normal.z > 0 ? box.max.z : box.min.z);
+        return glm::dot(plane.normal, far_corner) + plane.distance < 0;
+    }
+
+    // the box's corner nearest along the plane's normal is in front of it (so the whole box is):
+    inline bool inside(BBox const &box, Plane const &plane)
+    {
+        glm::vec3 near_corner(plane.normal.x > 0 ? box.min.x : box.max.x,
+                              plane.normal.y > 0 ? box.min.y : box.max.y,
+                              plane.normal.z > 0 ? box.min.z : box.max.z);
+        return glm::dot(plane.normal, near_corner) + plane.distance >= 0;
+    }
+}
+
+void SceneBVH::build(std::vector<BBox> const &bounds, std::vector<uint32_t> const &matrix_index, glm::mat4 const *matrices)
+{
+    assert(matrix_index.size() == bounds.size());
+    uint32_t count = uint32_t(bounds.size());
+    nodes.clear();
+    items.resize(count);
+    std::iota(items.begin(), items.end(), 0u);
+    leaf_of.assign(count, 0);
+    refit_marked.clear();
+
+    // (the tree is shaped by the objects' current world bounds)
+    std::vector<BBox> world_bounds(bounds);
+    std::vector<glm::vec3> centers(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!world_bounds[i].empty())
+            world_bounds[i].transform(matrices[matrix_index[i]]);
+        centers[i] = (world_bounds[i].empty() ? glm::vec3(0.0f) : world_bounds[i].center());
+    }
+    if (count != 0)
+    {
+        nodes.reserve(2 * size_t(count));
+        build_range(0, count, -1, world_bounds, centers);
+    }
+    refit_marked.assign(nodes.size(), 0);
+
+    // lay the objects out in slot order, then place them all:
+    slot_of.resize(count);
+    matrix_of.resize(count);
+    local.resize(count);
+    world.resize(count);
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        slot_of[items[slot]] = slot;
+        matrix_of[slot] = matrix_index[items[slot]];
+        local.set(slot, bounds[items[slot]]);
+    }
+    local.transform(matrices, matrix_of.data(), 0, count, &world);
+    refit(items);
+}
+
+uint32_t SceneBVH::build_range(uint32_t begin, uint32_t end, int32_t parent, std::vector<BBox> const &bounds, std::vector<glm::vec3> const &centers)
+{
+    uint32_t index = uint32_t(nodes.size());
+    nodes.emplace_back();
+
+    BBox box, center_box;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        box.enclose(bounds[items[i]]);
+        center_box.enclose(centers[items[i]]);
+    }
+    nodes[index].bounds = box;
+    nodes[index].first = begin;
+    nodes[index].count = end - begin;
+    nodes[index].parent = parent;
+
+    if (end - begin <= MaxLeafSize)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            leaf_of[items[i]] = index;
+        }
+        return index;
+    }
+
+    // bin the centers along each axis, and take the split with the least area-weighted object count on either side:
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    uint32_t best_split = 0;
+    auto bin_of = [&](uint32_t item, int axis)
+    {
+        float extent = center_box.max[axis] - center_box.min[axis];
+        float b = (centers[item][axis] - center_box.min[axis]) * (float(Bins) / extent);
+        return std::min(Bins - 1, uint32_t(std::max(b, 0.0f)));
+    };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (!(center_box.max[axis] > center_box.min[axis]))
+            continue;
+
+        std::array<BBox, Bins> bin_bounds;
+        std::array<uint32_t, Bins> bin_counts{};
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t b = bin_of(items[i], axis);
+            bin_counts[b] += 1;
+            bin_bounds[b].enclose(bounds[items[i]]);
+        }
+
+        // (right side of every split first, then sweep the left side across)
+        std::array<float, Bins> right_area{};
+        std::array<uint32_t, Bins> right_count{};
+        BBox side;
+        uint32_t count = 0;
+        for (uint32_t b = Bins - 1; b > 0; --b)
+        {
+            side.enclose(bin_bounds[b]);
+            count += bin_counts[b];
+            right_area[b] = side.surface_area();
+            right_count[b] = count;
+        }
+        side.reset();
+        count = 0;
+        for (uint32_t b = 0; b + 1 < Bins; ++b)
+        {
+            side.enclose(bin_bounds[b]);
+            count += bin_counts[b];
+            if (count == 0 || right_count[b + 1] == 0)
+                continue;
+            float cost = side.surface_area() * float(count) + right_area[b + 1] * float(right_count[b + 1]);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    uint32_t mid = begin + (end - begin) / 2; // (if every center coincides, just halve the objects)
+    if (best_axis >= 0)
+    {
+        auto split = std::partition(items.begin() + begin, items.begin() + end, [&](uint32_t item)
+                                    { return bin_of(item, best_axis) < best_split; });
+        mid = uint32_t(split - items.begin());
+        assert(mid > begin && mid < end);
+    }
+
+    build_range(begin, mid, int32_t(index), bounds, centers); // (lands at index + 1)
+    uint32_t second = build_range(mid, end, int32_t(index), bounds, centers);
+    nodes[index].second = second;
+    return index;
+}
+
+void SceneBVH::update(glm::mat4 const *matrices, std::vector<uint32_t> const &moved, JobSystem *jobs)
+{
+    if (nodes.empty() || moved.empty())
+        return;
+
+    if (moved.size() * 4 >= items.size())
+    {
+        // (much of the scene moved: place every slot, a register at a time, then refit sweeps every node)
+        auto place = [&](size_t begin, size_t end)
+        { local.transform(matrices, matrix_of.data(), uint32_t(begin), uint32_t(end), &world); };
+        if (jobs)
+            jobs->parallel_for(items.size(), ParallelSlots, place);
+        else
+            place(0, items.size());
+    }
+    else
+    {
+        for (uint32_t object : moved)
+        {
+            local.transform(matrices, matrix_of.data(), slot_of[object], slot_of[object] + 1, &world);
+        }
+    }
+    refit(moved);
+}
+
+void SceneBVH::refit(std::vector<uint32_t> const &moved)
+{
+    if (nodes.empty() || moved.empty())
+        return;
+
+    auto recompute = [&](uint32_t n)
+    {
+        Node &node = nodes[n];
+        node.bounds.reset();
+        if (node.second == 0)
+        {
+            for (uint32_t slot = node.first; slot < node.first + node.count; ++slot)
+            {
+                node.bounds.enclose(world.get(slot));
+            }
+        }
+        else
+        {
+            node.bounds.enclose(nodes[n + 1].bounds);
+            node.bounds.enclose(nodes[node.second].bounds);
+        }
+    };
+
+    // when much of the scene moved, sweeping every node (children come after their parents) is cheaper:
+    if (moved.size() * 4 >= items.size())
+    {
+        for (uint32_t n = uint32_t(nodes.size()); n-- > 0;)
+        {
+            recompute(n);
+        }
+        return;
+    }
+
+    // otherwise only the moved objects' leaves and their ancestors (each once), deepest first:
+    refit_nodes.clear();
+    for (uint32_t object : moved)
+    {
+        for (int32_t n = int32_t(leaf_of[object]); n >= 0 && !refit_marked[n]; n = nodes[n].parent)
+        {
+            refit_marked[n] = 1;
+            refit_nodes.emplace_back(uint32_t(n));
+        }
+    }
+    std::sort(refit_nodes.begin(), refit_nodes.end(), std::greater<uint32_t>());
+    for (uint32_t n : refit_nodes)
+    {
+        recompute(n);
+        refit_marked[n] = 0;
+    }
+}
+
+void SceneBVH::cull(std::array<Plane, 6> const &planes, std::vector<uint32_t> *visible)
+{
+    assert(visible);
+    if (nodes.empty())
+        return;
+
+    stack.clear();
+    stack.emplace_back(0, AllPlanes);
+    while (!stack.empty())
+    {
+        auto [n, mask] = stack.back();
+        stack.pop_back();
+        Node const &node = nodes[n];
+
+        // drop the planes this node is entirely in front of (its descendants are too):
+        bool rejected = false;
+        for (uint32_t p = 0; p < 6 && !rejected; ++p)
+        {
+            if (!(mask & (1u << p)))
+                continue;
+            if (outside(node.bounds, planes[p]))
+                rejected = true;
+            else if (inside(node.bounds, planes[p]))
+                mask &= ~(1u << p);
+        }
+        if (rejected)
+            continue;
+
+        if (mask == 0)
+        {
+            visible->insert(visible->end(), items.begin() + node.first, items.begin() + node.first + node.count);
+        }
+        else if (node.second == 0)
+        {
+            world.cull(planes, mask, node.first, node.first + node.count, items.data(), visible);
+        }
+        else
+        {
+            stack.emplace_back(node.second, mask);
+            stack.emplace_back(n + 1, mask);
+        }
+    }
+}
+
+void SceneBVH::benchmark(glm::mat4 const *matrices, std::array<Plane, 6> const &planes, uint32_t iterations)
+{
+    uint32_t count = uint32_t(items.size());
+    if (count == 0 || iterations == 0)
+    {
+        std::cout << "Culling benchmark: scene has no objects." << std::endl;
+        return;
+    }
+
+    std::vector<uint32_t> scalar_visible, batch_visible, tree_visible;
+    scalar_visible.reserve(count);
+    batch_visible.reserve(count);
+    tree_visible.reserve(count);
+    BoxBatch placed;
+    placed.resize(count);
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto before = Clock::now();
+    for (uint32_t it = 0; it < iterations; ++it)
+    {
+        scalar_visible.clear();
+        for (uint32_t slot = 0; slot < count; ++slot)
+        {
+            BBox box = local.get(slot);
+            box.transform(matrices[matrix_of[slot]]);
+            if (!box.is_bbox_outside_frustum(planes))
+                scalar_visible.emplace_back(items[slot]);
+        }
+    }
+    auto scalar_done = Clock::now();
+    for (uint32_t it = 0; it < iterations; ++it)
+    {
+        batch_visible.clear();
+        local.transform(matrices, matrix_of.data(), 0, count, &placed);
+        placed.cull(planes, AllPlanes, 0, count, items.data(), &batch_visible);
+    }
+    auto batch_done = Clock::now();
+    for (uint32_t it = 0; it < iterations; ++it)
+    {
+        tree_visible.clear();
+        cull(planes, &tree_visible);
+    }
+    auto tree_done = Clock::now();
+
+    // (untimed) objects the paths disagree on; the batched bounds are computed differently from BBox::transform,
+    //  so a few boxes touching a plane may round to the other side:
+    std::sort(scalar_visible.begin(), scalar_visible.end());
+    std::sort(batch_visible.begin(), batch_visible.end());
+    std::sort(tree_visible.begin(), tree_visible.end());
+    auto disagree = [](std::vector<uint32_t> const &a, std::vector<uint32_t> const &b)
+    {
+        std::vector<uint32_t> difference;
+        std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(difference));
+        return difference.size();
+    };
+
+    auto ms = [&](Clock::time_point a, Clock::time_point b)
+    { return std::chrono::duration<double, std::milli>(b - a).count() / iterations; };
+    double scalar_ms = ms(before, scalar_done), batch_ms = ms(scalar_done, batch_done), tree_ms = ms(batch_done, tree_done);
+    std::cout << "Culling benchmark: " << count << " objects (" << scalar_visible.size() << " visible), " << nodes.size()
+              << " tree nodes, " << BoxBatch::Width << " lanes wide, " << iterations << " iterations:\n"
+              << "  scalar  " << scalar_ms << " ms (transform + test every object)\n"
+              << "  batched " << batch_ms << " ms (" << (batch_ms > 0.0 ? scalar_ms / batch_ms : 0.0) << "x)\n"
+              << "  tree    " << tree_ms << " ms (" << (tree_ms > 0.0 ? scalar_ms / tree_ms : 0.0) << "x, objects already placed)\n"
+              << "  disagreements: batched " << disagree(scalar_visible, batch_visible) << ", tree " << disagree(scalar_visible, tree_visible) << std::endl;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BoxBatch.hpp"
+#include "lib/bbox.h"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct JobSystem;
+
+// Bounding volume hierarchy over the world-space bounds of scene objects, for frustum culling.
+//  Built top-down with a binned surface area heuristic; when objects move, only their leaves and the nodes
+//  above them are refit (the tree's shape is kept). Culling walks the tree with a mask of the planes still
+//  straddled, so a subtree entirely outside one plane is rejected whole, and one entirely inside every plane
+//  is accepted whole without testing its objects. Objects' bounds are kept in BoxBatches in leaf order, so
+//  placing moved objects and testing a leaf's objects are each one batched kernel call over a contiguous range.
+struct SceneBVH
+{
+    struct Node
+    {
+        BBox bounds;
+        uint32_t first = 0;  // this subtree's objects are items[first, first + count)
+        uint32_t count = 0;
+        uint32_t second = 0; // index of the second child (the first is the next node); 0 for leaves
+        int32_t parent = -1;
+    };
+    std::vector<Node> nodes;         // nodes[0] is the root; every subtree is contiguous, parents first
+    std::vector<uint32_t> items;     // object in each slot (slots are grouped by leaf)
+    std::vector<uint32_t> slot_of;   // slot holding each object
+    std::vector<uint32_t> leaf_of;   // leaf holding each object
+    BoxBatch local;                  // [slot] object bounds in the object's own space
+    std::vector<uint32_t> matrix_of; // [slot] index of the object's matrix (WORLD_FROM_LOCAL)
+    BoxBatch world;                  // [slot] object bounds in world space, as of the last build() / update()
+
+    static constexpr uint32_t MaxLeafSize = 8;      // objects per leaf (one AVX2 register), unless they can't be told apart
+    static constexpr uint32_t Bins = 16;            // split candidates per axis (minus one)
+    static constexpr uint32_t ParallelSlots = 1024; // slots per job when update() places everything
+
+    bool empty() const { return nodes.empty(); }
+
+    // build over objects with bounds bounds[i] in their own space, placed by matrices[matrix_index[i]]:
+    void build(std::vector<BBox> const &bounds, std::vector<uint32_t> const &matrix_index, glm::mat4 const *matrices);
+    // place the 'moved' objects by their (changed) matrices, and refit the nodes above them:
+    void update(glm::mat4 const *matrices, std::vector<uint32_t> const &moved, JobSystem *jobs = nullptr);
+    void refit(std::vector<uint32_t> const &moved); // (just the refit, for objects whose world bounds are already placed)
+    // append the objects whose bounds are not entirely outside one of 'planes' (from extract_planes) to *visible:
+    void cull(std::array<Plane, 6> const &planes, std::vector<uint32_t> *visible);
+
+    // time 'iterations' culls against 'planes' three ways -- per-object BBox::transform + is_bbox_outside_frustum,
+    //  BoxBatch::transform + BoxBatch::cull over every object, and cull() through the tree -- and print the
+    //  timings and any disagreement (`--benchmark-culling`):
+    void benchmark(glm::mat4 const *matrices, std::array<Plane, 6> const &planes, uint32_t iterations);
+
+    uint32_t build_range(uint32_t begin, uint32_t end, int32_t parent, std::vector<BBox> const &bounds, std::vector<glm::vec3> const &centers);
+    std::vector<uint32_t> refit_nodes;                // (scratch for refit)
+    std::vector<uint8_t> refit_marked;                // (scratch for refit) [node]
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // (scratch for cull) node, planes left to test
+};
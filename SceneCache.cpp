@@ -0,0 +1,563 @@
+#include "SceneCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <type_traits>
+
+extern S72_scene s72_scene;
+
+namespace
+{
+    constexpr uint32_t Magic = 0x43323753; // "S72C" (little-endian)
+
+    // 64-bit hash, eight bytes at a time (it only needs to notice edits, not resist attacks):
+    struct Hasher
+    {
+        uint64_t h = 0xcbf29ce484222325ull;
+
+        void mix(uint64_t v)
+        {
+            h ^= v;
+            h *= 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        void add(void const *data, size_t size)
+        {
+            char const *bytes = reinterpret_cast<char const *>(data);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t v;
+                std::memcpy(&v, bytes + i, 8);
+                mix(v);
+            }
+            uint64_t tail = 0;
+            if (i < size)
+                std::memcpy(&tail, bytes + i, size - i);
+            mix(tail ^ (uint64_t(size) << 56));
+        }
+    };
+
+    //------------------------------------------
+    // serialization helpers:
+
+    struct Writer
+    {
+        std::vector<char> data;
+
+        template <typename T>
+        void pod(T const &value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "only plain data is written directly");
+            data.insert(data.end(), reinterpret_cast<char const *>(&value), reinterpret_cast<char const *>(&value) + sizeof(T));
+        }
+        void str(std::string const &s)
+        {
+            pod(uint32_t(s.size()));
+            data.insert(data.end(), s.begin(), s.end());
+        }
+        template <typename T>
+        void array(std::vector<T> const &v)
+        {
+            pod(uint32_t(v.size()));
+            data.insert(data.end(), reinterpret_cast<char const *>(v.data()), reinterpret_cast<char const *>(v.data() + v.size()));
+        }
+        void name_or_index(std::variant<std::string, double> const &v)
+        {
+            pod(uint8_t(v.index()));
+            if (std::holds_alternative<std::string>(v))
+                str(std::get<std::string>(v));
+            else
+                pod(std::get<double>(v));
+        }
+    };
+
+    struct Reader
+    {
+        char const *at;
+        char const *end;
+
+        // all reads check bounds, so a truncated/corrupt file fails cleanly:
+        void bytes(void *out, size_t size)
+        {
+            if (size == 0)
+                return;
+            if (size_t(end - at) < size)
+                throw std::runtime_error("scene cache is truncated");
+            std::memcpy(out, at, size);
+            at += size;
+        }
+        template <typename T>
+        T pod()
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "only plain data is read directly");
+            T value;
+            bytes(&value, sizeof(T));
+            return value;
+        }
+        std::string str()
+        {
+            uint32_t size = pod<uint32_t>();
+            if (size_t(end - at) < size)
+                throw std::runtime_error("scene cache is truncated");
+            std::string s(at, size);
+            at += size;
+            return s;
+        }
+        template <typename T>
+        void array(std::vector<T> *out)
+        {
+            uint32_t count = pod<uint32_t>();
+            if (size_t(end - at) / sizeof(T) < count)
+                throw std::runtime_error("scene cache is truncated");
+            out->resize(count);
+            bytes(out->data(), count * sizeof(T));
+        }
+        std::variant<std::string, double> name_or_index()
+        {
+            if (pod<uint8_t>() == 0)
+                return str();
+            return pod<double>();
+        }
+    };
+
+    // pointers into s72_scene's vectors are stored as indices (-1 for nullptr, or anything not in the vector):
+    template <typename T>
+    int32_t index_of(T const *ptr, std::vector<T> const &vec)
+    {
+        std::less<T const *> less;
+        if (ptr == nullptr || less(ptr, vec.data()) || !less(ptr, vec.data() + vec.size()))
+            return -1;
+        return int32_t(ptr - vec.data());
+    }
+
+    template <typename T>
+    T *pointer_at(int32_t index, std::vector<T> &vec)
+    {
+        if (index < 0)
+            return nullptr;
+        if (size_t(index) >= vec.size())
+            throw std::runtime_error("scene cache has an out-of-range index");
+        return &vec[index];
+    }
+
+    std::vector<std::string> referenced_b72s(S72_scene const &scene)
+    {
+        std::vector<std::string> srcs;
+        for (auto const &mesh : scene.meshes)
+        {
+            for (auto const &[name, attr] : mesh.attributes)
+            {
+                srcs.emplace_back(attr.src);
+            }
+            if (!mesh.Indices.src.empty())
+            {
+                srcs.emplace_back(mesh.Indices.src);
+            }
+        }
+        std::sort(srcs.begin(), srcs.end());
+        srcs.erase(std::unique(srcs.begin(), srcs.end()), srcs.end());
+        return srcs;
+    }
+}
+
+std::string SceneCache::path_for(std::string const &s72_path)
+{
+    return s72_path + ".cache";
+}
+
+uint64_t SceneCache::hash_sources(std::string const &s72_path, std::vector<std::string> const &b72_srcs)
+{
+    std::filesystem::path dir = std::filesystem::path(s72_path).parent_path();
+
+    Hasher hasher;
+    auto add_file = [&](std::string const &path)
+    {
+        MappedFile file;
+        if (!file.map(path))
+        {
+            // missing files hash differently from empty ones:
+            hasher.mix(~uint64_t(0));
+            return;
+        }
+        hasher.add(file.data, file.size);
+    };
+
+    add_file(s72_path);
+    for (auto const &src : b72_srcs)
+    {
+        hasher.add(src.data(), src.size());
+        add_file((dir / src).string());
+    }
+    return hasher.h;
+}
+
+bool SceneCache::load(std::string const &s72_path, uint32_t options)
+{
+    std::string cache_path = path_for(s72_path);
+    if (!file.map(cache_path))
+        return false;
+
+    try
+    {
+        Reader r{file.data, file.data + file.size};
+
+        if (r.pod<uint32_t>() != Magic || r.pod<uint32_t>() != Version || r.pod<uint32_t>() != sizeof(SceneAttributes) || r.pod<uint32_t>() != sizeof(PackedSceneAttributes) || r.pod<uint32_t>() != options)
+        {
+            std::cout << "Scene cache " << cache_path << " is from a different version or options; rebuilding.\n";
+            file.unmap();
+            return false;
+        }
+
+        uint64_t hash = r.pod<uint64_t>();
+        std::vector<std::string> b72_srcs(r.pod<uint32_t>());
+        for (auto &src : b72_srcs)
+        {
+            src = r.str();
+        }
+        if (hash != hash_sources(s72_path, b72_srcs))
+        {
+            std::cout << "Scene cache " << cache_path << " is out of date; rebuilding.\n";
+            file.unmap();
+            return false;
+        }
+
+        // the cache is current, so restore the scene snapshot:
+        S72_scene scene;
+
+        scene.scene.name = r.str();
+        scene.scene.roots.resize(r.pod<uint32_t>());
+        for (auto &root : scene.scene.roots)
+        {
+            root = r.name_or_index();
+        }
+        scene.animation_duration = r.pod<float>();
+
+        // vectors are sized first so pointers into them can be restored while reading:
+        scene.nodes.resize(r.pod<uint32_t>());
+        scene.meshes.resize(r.pod<uint32_t>());
+        scene.cameras.resize(r.pod<uint32_t>());
+        scene.drivers.resize(r.pod<uint32_t>());
+
+        for (auto &node : scene.nodes)
+        {
+            node.name = r.str();
+            node.position = r.pod<glm::vec3>();
+            node.rotation = r.pod<glm::quat>();
+            node.scale = r.pod<glm::vec3>();
+            node.children.resize(r.pod<uint32_t>());
+            for (auto &child : node.children)
+            {
+                child = r.name_or_index();
+            }
+            node.children_node_.resize(r.pod<uint32_t>());
+            for (auto &child : node.children_node_)
+            {
+                child = pointer_at(r.pod<int32_t>(), scene.nodes);
+            }
+            node.mesh_name = r.str();
+            node.camera_name = r.str();
+            node.environment_name = r.str();
+            node.light_name = r.str();
+            node.parent_ = pointer_at(r.pod<int32_t>(), scene.nodes);
+            node.mesh_ = pointer_at(r.pod<int32_t>(), scene.meshes);
+            node.camera_ = pointer_at(r.pod<int32_t>(), scene.cameras);
+        }
+
+        scene.mesh_vertices.resize(scene.meshes.size());
+        scene.mesh_bboxes.resize(scene.meshes.size());
+        for (auto &mesh : scene.meshes)
+        {
+            mesh.index_ = uint32_t(&mesh - scene.meshes.data());
+            mesh.name = r.str();
+            mesh.topology = r.str();
+            mesh.count = r.pod<uint32_t>();
+            mesh.Indices.src = r.str();
+            mesh.Indices.offset = r.pod<uint32_t>();
+            mesh.Indices.format = r.str();
+            uint32_t attribute_count = r.pod<uint32_t>();
+            for (uint32_t i = 0; i < attribute_count; ++i)
+            {
+                std::string name = r.str();
+                Mesh::Attribute attr;
+                attr.src = r.str();
+                attr.offset = r.pod<uint32_t>();
+                attr.stride = r.pod<uint32_t>();
+                attr.format = r.str();
+                mesh.attributes.emplace(std::move(name), std::move(attr));
+            }
+            mesh.material = r.str();
+
+            // ranges and bounds computed while decoding:
+            MsehVertices vertices;
+            vertices.first = r.pod<uint32_t>();
+            vertices.count = r.pod<uint32_t>();
+            vertices.index_count = r.pod<uint32_t>();
+            vertices.index_offset = r.pod<uint64_t>();
+            vertices.index_type = VkIndexType(r.pod<uint32_t>());
+            scene.mesh_vertices[mesh.index_] = vertices;
+            glm::vec3 min = r.pod<glm::vec3>();
+            glm::vec3 max = r.pod<glm::vec3>();
+            scene.mesh_bboxes[mesh.index_] = BBox(min, max);
+        }
+
+        for (auto &camera : scene.cameras)
+        {
+            camera.name = r.str();
+            camera.perspective.aspect = r.pod<float>();
+            camera.perspective.vfov = r.pod<float>();
+            camera.perspective.near = r.pod<float>();
+            camera.perspective.far = r.pod<float>();
+        }
+
+        for (auto &driver : scene.drivers)
+        {
+            driver.name = r.str();
+            driver.refnode_name = r.str();
+            driver.channel = DriverChannleType(r.pod<uint32_t>());
+            driver.channel_dim = r.pod<uint32_t>();
+            driver.interpolation = DriverInterpolation(r.pod<uint32_t>());
+            r.array(&driver.times);
+            r.array(&driver.values);
+            driver.compressed = (r.pod<uint8_t>() != 0);
+            r.array(&driver.packed);
+            driver.range_min = r.pod<glm::vec3>();
+            driver.range_scale = r.pod<glm::vec3>();
+            if (driver.compressed ? driver.packed.size() != driver.times.size() * 3 : driver.values.size() != driver.times.size() * driver.channel_dim)
+                throw std::runtime_error("scene cache has mismatched driver keyframes");
+            driver.position_init = r.pod<glm::vec3>();
+            driver.scale_init = r.pod<glm::vec3>();
+            driver.rotation_init = r.pod<glm::quat>();
+        }
+
+        uint32_t node_names = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < node_names; ++i)
+        {
+            std::string name = r.str();
+            scene.nodes_map[name] = pointer_at(r.pod<int32_t>(), scene.nodes);
+        }
+
+        uint32_t camera_paths = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < camera_paths; ++i)
+        {
+            std::vector<Node *> &path = scene.cameras_path[r.str()];
+            path.resize(r.pod<uint32_t>());
+            for (auto &node : path)
+            {
+                node = pointer_at(r.pod<int32_t>(), scene.nodes);
+            }
+        }
+
+        scene.camera_mode = Camera_Mode(r.pod<uint32_t>());
+        scene.current_camera_ = pointer_at(r.pod<int32_t>(), scene.cameras);
+
+        // vertex and index data are last, at aligned offsets, and are handed out straight from the mapping:
+        auto block = [&](size_t *offset_out, size_t *bytes_out)
+        {
+            uint64_t bytes = r.pod<uint64_t>();
+            uint64_t offset = r.pod<uint64_t>();
+            if (offset > file.size || bytes > file.size - offset)
+                throw std::runtime_error("scene cache data is truncated");
+            *offset_out = size_t(offset);
+            *bytes_out = size_t(bytes);
+        };
+        vertex_count_ = r.pod<uint32_t>();
+        block(&vertex_offset, &vertex_bytes_);
+        block(&index_offset, &index_bytes_);
+        if (vertex_bytes_ != SceneVertexStreams{.count = vertex_count_, .packed = (options & Packed) != 0}.total_bytes())
+            throw std::runtime_error("scene cache vertex data has the wrong size");
+
+        // (moving vectors keeps element addresses, so the restored pointers stay valid)
+        s72_scene = std::move(scene);
+        index_scene_names();
+    }
+    catch (std::exception const &e)
+    {
+        std::cerr << "Ignoring scene cache " << cache_path << ": " << e.what() << std::endl;
+        file.unmap();
+        return false;
+    }
+
+    std::cout << "Using scene cache " << cache_path << ".\n";
+    return true;
+}
+
+void SceneCache::save(std::string const &s72_path, uint32_t options, uint32_t vertex_count, void const *vertices, size_t vertex_bytes, void const *indices, size_t index_bytes)
+{
+    std::vector<std::string> b72_srcs = referenced_b72s(s72_scene);
+
+    Writer w;
+    w.pod(Magic);
+    w.pod(Version);
+    w.pod(uint32_t(sizeof(SceneAttributes)));
+    w.pod(uint32_t(sizeof(PackedSceneAttributes)));
+    w.pod(options);
+    w.pod(hash_sources(s72_path, b72_srcs));
+    w.pod(uint32_t(b72_srcs.size()));
+    for (auto const &src : b72_srcs)
+    {
+        w.str(src);
+    }
+
+    w.str(s72_scene.scene.name);
+    w.pod(uint32_t(s72_scene.scene.roots.size()));
+    for (auto const &root : s72_scene.scene.roots)
+    {
+        w.name_or_index(root);
+    }
+    w.pod(s72_scene.animation_duration);
+
+    w.pod(uint32_t(s72_scene.nodes.size()));
+    w.pod(uint32_t(s72_scene.meshes.size()));
+    w.pod(uint32_t(s72_scene.cameras.size()));
+    w.pod(uint32_t(s72_scene.drivers.size()));
+
+    for (auto const &node : s72_scene.nodes)
+    {
+        w.str(node.name);
+        w.pod(node.position);
+        w.pod(node.rotation);
+        w.pod(node.scale);
+        w.pod(uint32_t(node.children.size()));
+        for (auto const &child : node.children)
+        {
+            w.name_or_index(child);
+        }
+        w.pod(uint32_t(node.children_node_.size()));
+        for (Node const *child : node.children_node_)
+        {
+            w.pod(index_of(child, s72_scene.nodes));
+        }
+        w.str(node.mesh_name);
+        w.str(node.camera_name);
+        w.str(node.environment_name);
+        w.str(node.light_name);
+        w.pod(index_of<Node>(node.parent_, s72_scene.nodes));
+        w.pod(index_of<Mesh>(node.mesh_, s72_scene.meshes));
+        w.pod(index_of<Camera>(node.camera_, s72_scene.cameras));
+    }
+
+    for (auto const &mesh : s72_scene.meshes)
+    {
+        w.str(mesh.name);
+        w.str(mesh.topology);
+        w.pod(mesh.count);
+        w.str(mesh.Indices.src);
+        w.pod(mesh.Indices.src.empty() ? 0u : mesh.Indices.offset); // (offset is left uninitialized when there are no indices)
+        w.str(mesh.Indices.format);
+        w.pod(uint32_t(mesh.attributes.size()));
+        for (auto const &[name, attr] : mesh.attributes)
+        {
+            w.str(name);
+            w.str(attr.src);
+            w.pod(attr.offset);
+            w.pod(attr.stride);
+            w.str(attr.format);
+        }
+        w.str(mesh.material);
+
+        MsehVertices vertices;
+        if (mesh.index_ < s72_scene.mesh_vertices.size())
+            vertices = s72_scene.mesh_vertices[mesh.index_];
+        w.pod(vertices.first);
+        w.pod(vertices.count);
+        w.pod(vertices.index_count);
+        w.pod(uint64_t(vertices.index_offset));
+        w.pod(uint32_t(vertices.index_type));
+        BBox bbox;
+        if (mesh.index_ < s72_scene.mesh_bboxes.size())
+            bbox = s72_scene.mesh_bboxes[mesh.index_];
+        w.pod(bbox.min);
+        w.pod(bbox.max);
+    }
+
+    for (auto const &camera : s72_scene.cameras)
+    {
+        w.str(camera.name);
+        w.pod(camera.perspective.aspect);
+        w.pod(camera.perspective.vfov);
+        w.pod(camera.perspective.near);
+        w.pod(camera.perspective.far);
+    }
+
+    for (auto const &driver : s72_scene.drivers)
+    {
+        w.str(driver.name);
+        w.str(driver.refnode_name);
+        w.pod(uint32_t(driver.channel));
+        w.pod(driver.channel_dim);
+        w.pod(uint32_t(driver.interpolation));
+        w.array(driver.times);
+        w.array(driver.values);
+        w.pod(uint8_t(driver.compressed ? 1 : 0));
+        w.array(driver.packed);
+        w.pod(driver.range_min);
+        w.pod(driver.range_scale);
+        w.pod(driver.position_init);
+        w.pod(driver.scale_init);
+        w.pod(driver.rotation_init);
+    }
+
+    w.pod(uint32_t(s72_scene.nodes_map.size()));
+    for (auto const &[name, node] : s72_scene.nodes_map)
+    {
+        w.str(name);
+        w.pod(index_of<Node>(node, s72_scene.nodes));
+    }
+
+    w.pod(uint32_t(s72_scene.cameras_path.size()));
+    for (auto const &[name, path] : s72_scene.cameras_path)
+    {
+        w.str(name);
+        w.pod(uint32_t(path.size()));
+        for (Node const *node : path)
+        {
+            w.pod(index_of(node, s72_scene.nodes));
+        }
+    }
+
+    w.pod(uint32_t(s72_scene.camera_mode));
+    w.pod(index_of<Camera>(s72_scene.current_camera_, s72_scene.cameras));
+
+    // vertex and index data go last, 16-byte aligned:
+    w.pod(vertex_count);
+    uint64_t vertex_offset = (w.data.size() + 4 * sizeof(uint64_t) + 15) & ~uint64_t(15);
+    uint64_t index_offset = (vertex_offset + vertex_bytes + 15) & ~uint64_t(15);
+    w.pod(uint64_t(vertex_bytes));
+    w.pod(vertex_offset);
+    w.pod(uint64_t(index_bytes));
+    w.pod(index_offset);
+    w.data.resize(size_t(vertex_offset));
+
+    // write to a temporary file and rename, so a crash never leaves a half-written cache behind:
+    std::string cache_path = path_for(s72_path);
+    std::string temp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary);
+        out.write(w.data.data(), std::streamsize(w.data.size()));
+        out.write(reinterpret_cast<char const *>(vertices), std::streamsize(vertex_bytes));
+        std::array<char, 16> padding{};
+        out.write(padding.data(), std::streamsize(index_offset - (vertex_offset + vertex_bytes)));
+        out.write(reinterpret_cast<char const *>(indices), std::streamsize(index_bytes));
+        if (!out)
+        {
+            std::cerr << "Failed to write scene cache " << temp_path << std::endl;
+            out.close();
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp_path, cache_path, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to write scene cache " << cache_path << ": " << ec.message() << std::endl;
+        std::remove(temp_path.c_str());
+        return;
+    }
+    std::cout << "Wrote scene cache " << cache_path << ".\n";
+}
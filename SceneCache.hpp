@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "lib/MappedFile.hpp"
+#include "lib/SceneVertex.hpp"
+
+#include <cstdint>
+#include <string>
+
+// On-disk snapshot of a fully loaded scene, written beside the .s72 as "<scene>.s72.cache".
+//  Holds the resolved s72_scene (nodes, meshes, cameras, drivers, bboxes, vertex ranges) and the
+//  final scene vertex data, so a warm start skips JSON parsing, tree building and .b72 decoding.
+//  The cache is only used if a hash over the .s72 and every .b72 it references still matches.
+struct SceneCache
+{
+    // bump whenever the file layout (or anything serialized, e.g. SceneVertex) changes:
+    static constexpr uint32_t Version = 6;
+
+    // load options that change the cached data; a cache is only used with the options it was saved with:
+    enum Options : uint32_t
+    {
+        Welded = 1, // vertices were welded (--weld)
+        Packed = 2, // vertex attributes are PackedSceneAttributes (--packed-vertices)
+        CompressedAnimation = 4, // driver keyframes went through compress_drivers (--compress-animation)
+    };
+
+    static std::string path_for(std::string const &s72_path);
+
+    // hash of the contents of the .s72 and all (deduplicated, sorted) .b72 sources it references:
+    static uint64_t hash_sources(std::string const &s72_path, std::vector<std::string> const &b72_srcs);
+
+    // if the cache for 's72_path' exists and is current, replace s72_scene with its snapshot and return true:
+    bool load(std::string const &s72_path, uint32_t options);
+
+    // valid after a successful load(); vertex data is laid out as SceneVertexStreams{vertex_count(), options & Packed}:
+    uint32_t vertex_count() const { return vertex_count_; }
+    size_t vertex_bytes() const { return vertex_bytes_; }
+    void const *vertex_data() const { return file.data + vertex_offset; }
+    size_t index_bytes() const { return index_bytes_; }
+    uint8_t const *index_data() const { return reinterpret_cast<uint8_t const *>(file.data + index_offset); }
+
+    // write a cache for the current s72_scene and the given vertex and index data (failure is reported, not fatal):
+    static void save(std::string const &s72_path, uint32_t options, uint32_t vertex_count, void const *vertices, size_t vertex_bytes, void const *indices, size_t index_bytes);
+
+private:
+    MappedFile file;
+    uint32_t vertex_count_ = 0;
+    size_t vertex_offset = 0;
+    size_t vertex_bytes_ = 0;
+    size_t index_offset = 0;
+    size_t index_bytes_ = 0;
+};
@@ -8,12 +8,15 @@
 #include "helper/VK.hpp"
 #include <vulkan/vk_enum_string_helper.h>
 #include "GLFW\glfw3.h"
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <numeric>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <chrono>
@@ -22,6 +25,7 @@
 
 #include "include/sejp/sejp.hpp"
 #include "lib/bbox.h"
+#include "lib/MappedFile.hpp"
 
 std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
 
@@ -29,10 +33,11 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 {
 	// select a depth format:
 	//   (at least one of these two must be supported, according to the spec; but neither are required)
+	//   (`--culling hiz` also samples it to build the depth pyramid; D32_SFLOAT is required to support that)
 	depth_format = rtg.helpers.find_image_format(
 		{VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32},
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | (rtg.configuration.cull_mode == HIZ ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0));
 
 	// in Tutorial::Tutorial:
 	{ // create render pass
@@ -117,6 +122,33 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		};
 
 		VK(vkCreateRenderPass(rtg.device, &create_info, nullptr, &render_pass));
+
+		if (rtg.configuration.cull_mode == HIZ)
+		{ // a depth-only pass compatible with render_pass (same attachments, so same framebuffers and pipelines)
+			//  that leaves depth readable for depth_pyramid_pipeline; color is neither loaded nor stored:
+			attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+			std::array<VkSubpassDependency, 3> occluder_dependencies{
+				dependencies[0],
+				dependencies[1],
+				VkSubpassDependency{
+					// depth is read by the pyramid build; Transforms are rewritten by the second cull phase:
+					.srcSubpass = 0,
+					.dstSubpass = VK_SUBPASS_EXTERNAL,
+					.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				}};
+			create_info.pDependencies = occluder_dependencies.data();
+			create_info.dependencyCount = uint32_t(occluder_dependencies.size());
+
+			VK(vkCreateRenderPass(rtg.device, &create_info, nullptr, &occluder_render_pass));
+		}
 	}
 
 	{ // create command pool
@@ -139,12 +171,40 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 	}
 
 	scenes_pipeline.create(rtg, render_pass, 0);
+	if (rtg.configuration.gpu_transforms)
+	{
+		transforms_pipeline.create(rtg);
+	}
+	if (rtg.configuration.gpu_culling())
+	{
+		cull_pipeline.create(rtg, rtg.draw_indirect_count, rtg.configuration.cull_mode == HIZ);
+	}
+	if (rtg.configuration.cull_mode == HIZ)
+	{
+		depth_pyramid_pipeline.create(rtg);
+
+		VkSamplerCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.minLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE,
+			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+			.unnormalizedCoordinates = VK_FALSE,
+		};
+		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &depth_pyramid_sampler));
+	}
+	playmode.cull_mode = rtg.configuration.cull_mode;
 
 	// create descriptor pool:
 	{
 		uint32_t per_workspace = uint32_t(rtg.workspaces.size()); // for easier-to-read counting
 
-		std::array<VkDescriptorPoolSize, 2> pool_sizes{
+		std::array<VkDescriptorPoolSize, 3> pool_sizes{
 			VkDescriptorPoolSize{
 				// for camera
 				.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -153,14 +213,19 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			VkDescriptorPoolSize{
 				// for transform
 				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				.descriptorCount = 2 * per_workspace, // 2 descriptor per set, one set per workspace
+				.descriptorCount = 13 * per_workspace, // 2 transforms sets, plus 5 in the transforms_pipeline set and 6 in the cull_pipeline set, per workspace
+			},
+			VkDescriptorPoolSize{
+				// for the depth pyramid
+				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1 * per_workspace, // 1 in the cull_pipeline set, per workspace
 			},
 		};
 
 		VkDescriptorPoolCreateInfo create_info{
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 			.flags = 0,					  // because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, *can't* free individual descriptors allocated from this pool
-			.maxSets = 6 * per_workspace, // three set per workspace
+			.maxSets = 8 * per_workspace, // (at most) eight sets per workspace
 			.poolSizeCount = uint32_t(pool_sizes.size()),
 			.pPoolSizes = pool_sizes.data(),
 		};
@@ -168,6 +233,16 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &descriptor_pool));
 	}
 
+	{ // ranges inside Workspace::frame_data are bound at offsets, so respect the offset alignment limits:
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(rtg.physical_device, &properties);
+		frame_data_alignment = std::max({
+			frame_data_alignment,
+			properties.limits.minUniformBufferOffsetAlignment,
+			properties.limits.minStorageBufferOffsetAlignment,
+		});
+	}
+
 	workspaces.resize(rtg.workspaces.size());
 	std::cout << "\nworkspace size:" << workspaces.size() << "\n";
 
@@ -185,19 +260,6 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 
 		if (!rtg.configuration.headless)
 		{
-			workspace.Camera_src = rtg.helpers.create_buffer(
-				sizeof(LinesPipeline::Camera),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// get a pointer to the memory
-			);
-			workspace.Camera = rtg.helpers.create_buffer(
-				sizeof(LinesPipeline::Camera),
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as a uniform buffer, also going to have GPU copy into this memory
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU-local memory
-				Helpers::Unmapped													   // don't get a pointer to the memory
-			);
-
 			{ // allocate descriptor set for Camera descriptor
 				VkDescriptorSetAllocateInfo alloc_info{
 					.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -209,17 +271,6 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Camera_descriptors));
 			}
 
-			workspace.World_src = rtg.helpers.create_buffer(
-				sizeof(ObjectsPipeline::World),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				Helpers::Mapped);
-			workspace.World = rtg.helpers.create_buffer(
-				sizeof(ObjectsPipeline::World),
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				Helpers::Unmapped);
-
 			{ // allocate descriptor set for World descriptor
 				VkDescriptorSetAllocateInfo alloc_info{
 					.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -229,7 +280,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				};
 
 				VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.World_descriptors));
-				// NOTE: will actually fill in this descriptor set just a bit lower
+				// NOTE: update_frame_data (below) fills in this descriptor set
 			}
 
 			{ // allocate descriptor set for Transforms descriptor
@@ -245,19 +296,6 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			}
 		}
 
-		workspace.Scene_world_src = rtg.helpers.create_buffer(
-			sizeof(ScenesPipeline::World),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-			Helpers::Mapped																// get a pointer to the memory
-		);
-		workspace.Scene_world = rtg.helpers.create_buffer(
-			sizeof(ScenesPipeline::World),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as a uniform buffer, also going to have GPU copy into this memory
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU-local memory
-			Helpers::Unmapped													   // don't get a pointer to the memory
-		);
-
 		{ // allocate descriptor set for Scene_camera descriptor
 			VkDescriptorSetAllocateInfo alloc_info{
 				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -281,68 +319,35 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			// NOTE: will fill in this descriptor set in render when buffers are [re-]allocated
 		}
 
-		{ // point descriptor to buffer:
-			VkDescriptorBufferInfo Camera_info{
-				.buffer = workspace.Camera.handle,
-				.offset = 0,
-				.range = workspace.Camera.size,
+		if (rtg.configuration.gpu_transforms)
+		{ // allocate descriptor set for transforms_pipeline
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &transforms_pipeline.set0_Nodes,
 			};
 
-			VkDescriptorBufferInfo World_info{
-				.buffer = workspace.World.handle,
-				.offset = 0,
-				.range = workspace.World.size,
-			};
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Scene_nodes_descriptors));
+			// NOTE: update_frame_data fills in the per-frame ranges; the levels buffer is filled in once the scene is loaded
+		}
 
-			VkDescriptorBufferInfo Scene_world_info{
-				.buffer = workspace.Scene_world.handle,
-				.offset = 0,
-				.range = workspace.Scene_world.size,
+		if (rtg.configuration.gpu_culling())
+		{ // allocate descriptor set for cull_pipeline
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &cull_pipeline.set0_Objects,
 			};
 
-			std::vector<VkWriteDescriptorSet> writes;
-
-			if (!rtg.configuration.headless)
-			{
-				{
-					writes.emplace_back(VkWriteDescriptorSet{
-						.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-						.dstSet = workspace.Camera_descriptors,
-						.dstBinding = 0,
-						.dstArrayElement = 0,
-						.descriptorCount = 1,
-						.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-						.pBufferInfo = &Camera_info,
-					});
-					writes.emplace_back(VkWriteDescriptorSet{
-						.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-						.dstSet = workspace.World_descriptors,
-						.dstBinding = 0,
-						.dstArrayElement = 0,
-						.descriptorCount = 1,
-						.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-						.pBufferInfo = &World_info,
-					});
-				};
-			}
-			writes.emplace_back(VkWriteDescriptorSet{
-				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-				.dstSet = workspace.Scene_world_descriptors,
-				.dstBinding = 0,
-				.dstArrayElement = 0,
-				.descriptorCount = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				.pBufferInfo = &Scene_world_info,
-			});
-
-			vkUpdateDescriptorSets(
-				rtg.device,				 // device
-				uint32_t(writes.size()), // descriptorWriteCount
-				writes.data(),			 // pDescriptorWrites
-				0,						 // descriptorCopyCount
-				nullptr					 // pDescriptorCopies
-			);
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Scene_cull_descriptors));
+			// NOTE: update_frame_data fills in the per-frame ranges; the objects (and visibility) buffers are filled in once the scene is loaded,
+			//  and the depth pyramid in on_swapchain
 		}
+
+		// allocate frame_data for the fixed-size ranges and point the descriptor sets at it:
+		update_frame_data(workspace, 0, 0, 0);
 	}
 	if (!rtg.configuration.headless)
 	{
@@ -422,21 +427,335 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 	}
 	{
 		// create scene object vertices
-		std::vector<SceneVertex> vertices;
+		auto before = std::chrono::high_resolution_clock::now();
 
-		load_vertex_from_b72(vertices);
+		// size of the vertex data before welding (staging must hold all of it while decoding):
+		size_t decoded_bytes = 0;
+		scene_streams.packed = rtg.configuration.packed_vertices;
+		if (scene_from_cache)
+		{
+			scene_streams.count = scene_cache.vertex_count();
+			decoded_bytes = scene_cache.vertex_bytes();
+		}
+		else
+		{
+			scene_streams.count = map_b72_files();
+			decoded_bytes = scene_streams.total_bytes();
+		}
+
+		// b72 data is decoded straight into mapped staging memory, then copied to the GPU once:
+		Helpers::AllocatedBuffer staging = rtg.helpers.create_buffer(
+			std::max<size_t>(decoded_bytes, 1),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			Helpers::Mapped);
+
+		char *staging_vertices = reinterpret_cast<char *>(staging.allocation.data());
+		std::vector<uint8_t> indices;
+		size_t bytes = 0;
+		if (scene_from_cache)
+		{
+			// warm start: vertex and index data (and mesh ranges / bboxes) come straight from the cache file:
+			bytes = decoded_bytes;
+			std::memcpy(staging_vertices, scene_cache.vertex_data(), bytes);
+			indices.assign(scene_cache.index_data(), scene_cache.index_data() + scene_cache.index_bytes());
+			build_scene_objects();
+		}
+		else
+		{
+			scene_streams.count = load_vertex_from_b72(staging_vertices, &indices);
+			bytes = scene_streams.total_bytes();
+			b72_files.clear();
+			b72_vertex_counts.clear();
+			b72_vertex_errors.clear();
+			if (rtg.configuration.scene_cache)
+			{
+				SceneCache::save(s72_path, scene_cache_options(), scene_streams.count, staging_vertices, bytes, indices.data(), indices.size());
+			}
+		}
+		scene_cache = SceneCache(); // done with the cached data
+
+		if (rtg.configuration.cull_mode == OCCLUSION)
+		{ // occluders for the software occlusion buffer: triangle-list meshes of at most MaxOccluderTriangles triangles,
+			//  largest world bounds (as loaded) first, with their triangles copied out of staging before it is uploaded:
+			ScenePosition const *positions = reinterpret_cast<ScenePosition const *>(staging_vertices);
+			std::vector<std::pair<float, uint32_t>> candidates; // (world bounds surface area, scene object)
+			for (uint32_t i = 0; i < scene_objects.size(); ++i)
+			{
+				SceneObject const &object = scene_objects[i];
+				MsehVertices const &vertices = object.scene_object_vertices;
+				uint32_t triangles = (vertices.index_count != 0 ? vertices.index_count : vertices.count) / 3;
+				if (s72_scene.meshes[object.mesh_index].topology != "TRIANGLE_LIST" || triangles == 0 || triangles > OcclusionBuffer::MaxOccluderTriangles)
+					continue;
+				BBox world = BBox(s72_scene.mesh_bboxes[object.mesh_index]).transform(s72_scene.hierarchy.world[object.node_index]);
+				candidates.emplace_back(world.surface_area(), i);
+			}
+			std::sort(candidates.begin(), candidates.end(), std::greater<>());
 
-		size_t bytes = vertices.size() * sizeof(vertices[0]);
+			std::vector<glm::vec3> corners;
+			for (auto [area, i] : candidates)
+			{
+				MsehVertices const &vertices = scene_objects[i].scene_object_vertices;
+				uint32_t count = (vertices.index_count != 0 ? vertices.index_count : vertices.count) / 3 * 3;
+				corners.clear();
+				for (uint32_t c = 0; c < count; ++c)
+				{
+					uint32_t vertex = c;
+					if (vertices.index_count != 0 && vertices.index_type == VK_INDEX_TYPE_UINT16)
+					{
+						uint16_t index;
+						std::memcpy(&index, indices.data() + vertices.index_offset + 2 * size_t(c), sizeof(index));
+						vertex = index;
+					}
+					else if (vertices.index_count != 0)
+					{
+						std::memcpy(&vertex, indices.data() + vertices.index_offset + 4 * size_t(c), sizeof(vertex));
+					}
+					ScenePosition const &position = positions[vertices.first + vertex];
+					corners.emplace_back(position.x, position.y, position.z);
+				}
+				// (a mesh over the budget is skipped; a smaller one may still fit)
+				occlusion_buffer.add_occluder(uint32_t(scene_objects[i].node_index), corners);
+			}
+			std::cout << "Occlusion buffer: " << occlusion_buffer.occluders.size() << " occluders, " << occlusion_buffer.corners.size() / 3 << " triangles.\n";
+		}
 
 		scene_vertices = rtg.helpers.create_buffer(
-			bytes,
+			std::max<size_t>(bytes, 1),
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			Helpers::Unmapped);
 
-		std::cout << "\nSSize: " << bytes << ", " << vertices.size() << " * " << sizeof(vertices[0]) << "\n\n";
-		// copy data to buffer:
-		rtg.helpers.transfer_to_buffer(vertices.data(), bytes, scene_vertices);
+		std::cout << "\nSSize: " << bytes << ", " << scene_streams.count << " * (" << sizeof(ScenePosition) << " + " << scene_streams.attribute_stride() << ")\n\n";
+		// copy data to buffer (staging is freed once the upload finishes):
+		if (bytes != 0)
+		{
+			rtg.helpers.queue_upload(std::move(staging), bytes, scene_vertices);
+		}
+		else
+		{
+			rtg.helpers.destroy_buffer(std::move(staging));
+		}
+
+		if (!indices.empty())
+		{
+			scene_indices = rtg.helpers.create_buffer(
+				indices.size(),
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped);
+			rtg.helpers.queue_upload(indices.data(), indices.size(), scene_indices);
+			std::cout << "Scene indices: " << indices.size() << " bytes.\n";
+		}
+
+		auto after = std::chrono::high_resolution_clock::now();
+		std::cout << "Loaded scene vertices in " << std::chrono::duration<double, std::milli>(after - before).count() << " ms.\n";
+	}
+
+	{ // bounding volume hierarchy over the scene objects, for culling:
+		auto before = std::chrono::high_resolution_clock::now();
+		std::vector<BBox> bounds(scene_objects.size());
+		std::vector<uint32_t> nodes(scene_objects.size());
+		for (size_t i = 0; i < scene_objects.size(); ++i)
+		{
+			bounds[i] = s72_scene.mesh_bboxes[scene_objects[i].mesh_index];
+			nodes[i] = uint32_t(scene_objects[i].node_index);
+		}
+		scene_bvh.build(bounds, nodes, s72_scene.hierarchy.world.data());
+		auto after = std::chrono::high_resolution_clock::now();
+		std::cout << "Scene BVH: " << scene_objects.size() << " objects, " << scene_bvh.nodes.size() << " nodes, built in "
+				  << std::chrono::duration<double, std::milli>(after - before).count() << " ms.\n";
+
+		if (rtg.configuration.benchmark_culling)
+		{
+			// (against the first scene camera's frustum, as update() will cull with it)
+			glm::mat4 CLIP_FROM_WORLD_SCENE(1.0f);
+			if (!s72_scene.cameras.empty())
+			{
+				Camera const &camera = s72_scene.cameras[0];
+				if (auto found = s72_scene.nodes_map.find(camera.name); found != s72_scene.nodes_map.end())
+				{
+					CLIP_FROM_WORLD_SCENE = mat4_perspective(camera.perspective.vfov, camera.perspective.aspect, camera.perspective.near, camera.perspective.far) * s72_scene.hierarchy.world_to_local(found->second->index_);
+				}
+			}
+			scene_bvh.benchmark(s72_scene.hierarchy.world.data(), extract_planes(CLIP_FROM_WORLD_SCENE), 1000);
+		}
+	}
+
+	if (rtg.configuration.gpu_transforms)
+	{ // s72_scene.hierarchy in level order for transforms_pipeline (nodes counting-sorted by depth):
+		NodeHierarchy const &hierarchy = s72_scene.hierarchy;
+		std::vector<uint32_t> depth(hierarchy.nodes.size());
+		transform_level_starts.assign(1, 0);
+		for (size_t i = 0; i < depth.size(); ++i)
+		{
+			int32_t parent = hierarchy.parents[i];
+			depth[i] = (parent < 0 ? 0 : depth[parent] + 1); // (parents precede their children)
+			if (depth[i] + 1 >= transform_level_starts.size())
+			{
+				transform_level_starts.resize(depth[i] + 2, 0);
+			}
+			transform_level_starts[depth[i] + 1] += 1;
+		}
+		for (size_t l = 1; l < transform_level_starts.size(); ++l)
+		{
+			transform_level_starts[l] += transform_level_starts[l - 1];
+		}
+
+		std::vector<TransformsPipeline::Level> levels(depth.size());
+		std::vector<uint32_t> next(transform_level_starts.begin(), transform_level_starts.end() - 1);
+		for (size_t i = 0; i < depth.size(); ++i)
+		{
+			levels[next[depth[i]]++] = TransformsPipeline::Level{.node = uint32_t(i), .parent = hierarchy.parents[i]};
+		}
+
+		size_t bytes = levels.size() * sizeof(levels[0]);
+		scene_transform_levels = rtg.helpers.create_buffer(
+			std::max<size_t>(bytes, sizeof(TransformsPipeline::Level)),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped);
+		if (bytes != 0)
+		{
+			rtg.helpers.queue_upload(levels.data(), bytes, scene_transform_levels);
+		}
+		std::cout << "Transform levels: " << transform_level_starts.size() - 1 << " levels, " << levels.size() << " nodes.\n";
+
+		// the levels never change, so point every workspace's set at them now:
+		for (Workspace &workspace : workspaces)
+		{
+			VkDescriptorBufferInfo info{
+				.buffer = scene_transform_levels.handle,
+				.offset = 0,
+				.range = VK_WHOLE_SIZE,
+			};
+			VkWriteDescriptorSet write{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = workspace.Scene_nodes_descriptors,
+				.dstBinding = 1,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &info,
+			};
+			vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
+		}
+	}
+
+	if (rtg.configuration.gpu_culling())
+	{ // scene objects for cull_pipeline, with each draw kind's commands laid out together:
+		std::vector<CullPipeline::Object> objects(scene_objects.size());
+		auto kind_of = [](MsehVertices const &vertices) -> CullPipeline::DrawKind
+		{
+			if (vertices.index_count == 0)
+				return CullPipeline::Unindexed;
+			return (vertices.index_type == VK_INDEX_TYPE_UINT16 ? CullPipeline::Indexed16 : CullPipeline::Indexed32);
+		};
+
+		scene_draw_counts.fill(0);
+		for (SceneObject const &object : scene_objects)
+		{
+			scene_draw_counts[kind_of(object.scene_object_vertices)] += 1;
+		}
+		uint32_t first = 0;
+		for (uint32_t kind = 0; kind < CullPipeline::DrawKinds; ++kind)
+		{
+			scene_draw_firsts[kind] = first;
+			first += scene_draw_counts[kind];
+		}
+
+		{ // every kind's commands are drawn with one call:
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(rtg.physical_device, &properties);
+			for (uint32_t count : scene_draw_counts)
+			{
+				if (count > properties.limits.maxDrawIndirectCount)
+					throw std::runtime_error("--culling gpu can draw at most " + std::to_string(properties.limits.maxDrawIndirectCount) + " objects of one kind, but the scene has " + std::to_string(count) + ".");
+			}
+		}
+
+		std::array<uint32_t, CullPipeline::DrawKinds> next = scene_draw_firsts;
+		for (size_t i = 0; i < scene_objects.size(); ++i)
+		{
+			SceneObject const &object = scene_objects[i];
+			MsehVertices const &vertices = object.scene_object_vertices;
+			BBox const &bounds = s72_scene.mesh_bboxes[object.mesh_index];
+			CullPipeline::DrawKind kind = kind_of(vertices);
+			VkDeviceSize index_size = (vertices.index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+			objects[i] = CullPipeline::Object{
+				.bbox_min{bounds.min.x, bounds.min.y, bounds.min.z, 0.0f},
+				.bbox_max{bounds.max.x, bounds.max.y, bounds.max.z, 0.0f},
+				.node = uint32_t(object.node_index),
+				.kind = kind,
+				.base = scene_draw_firsts[kind],
+				.slot = next[kind]++,
+				.count = (kind == CullPipeline::Unindexed ? vertices.count : vertices.index_count),
+				.first = vertices.first,
+				.first_index = (kind == CullPipeline::Unindexed ? 0 : uint32_t(vertices.index_offset / index_size)),
+			};
+		}
+
+		size_t bytes = objects.size() * sizeof(objects[0]);
+		scene_cull_objects = rtg.helpers.create_buffer(
+			std::max<size_t>(bytes, sizeof(CullPipeline::Object)),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped);
+		if (bytes != 0)
+		{
+			rtg.helpers.queue_upload(objects.data(), bytes, scene_cull_objects);
+		}
+		std::cout << "Cull objects: " << scene_draw_counts[CullPipeline::Unindexed] << " non-indexed, " << scene_draw_counts[CullPipeline::Indexed16] << " 16-bit indexed, "
+				  << scene_draw_counts[CullPipeline::Indexed32] << " 32-bit indexed; drawn with " << (rtg.draw_indirect_count ? "GPU-written counts" : "fixed counts") << ".\n";
+
+		if (rtg.configuration.cull_mode == HIZ)
+		{ // (every object counts as drawn last frame, so the first frame's occluders are everything in view)
+			std::vector<uint32_t> visible(std::max<size_t>(scene_objects.size(), 1), 1);
+			scene_cull_visibility = rtg.helpers.create_buffer(
+				visible.size() * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped);
+			rtg.helpers.queue_upload(visible.data(), visible.size() * sizeof(uint32_t), scene_cull_visibility);
+		}
+
+		// the objects never change (and visibility is shared by every frame), so point every workspace's set at them now:
+		for (Workspace &workspace : workspaces)
+		{
+			std::array<VkDescriptorBufferInfo, 2> infos{
+				VkDescriptorBufferInfo{
+					.buffer = scene_cull_objects.handle,
+					.offset = 0,
+					.range = VK_WHOLE_SIZE,
+				},
+				VkDescriptorBufferInfo{
+					.buffer = scene_cull_visibility.handle,
+					.offset = 0,
+					.range = VK_WHOLE_SIZE,
+				},
+			};
+			std::array<VkWriteDescriptorSet, 2> writes{
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Scene_cull_descriptors,
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &infos[0],
+				},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Scene_cull_descriptors,
+					.dstBinding = 5,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &infos[1],
+				},
+			};
+			vkUpdateDescriptorSets(rtg.device, (rtg.configuration.cull_mode == HIZ ? 2 : 1), writes.data(), 0, nullptr);
+		}
 	}
 
 	{ // make some textures
@@ -474,7 +793,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				Helpers::Unmapped));
 
 			// transfer data:
-			rtg.helpers.transfer_to_image(data.data(), sizeof(data[0]) * data.size(), textures.back());
+			rtg.helpers.queue_upload(data.data(), sizeof(data[0]) * data.size(), textures.back());
 		}
 
 		{ // texture 1 will be a classic 'xor' texture:
@@ -505,10 +824,14 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				Helpers::Unmapped));
 
 			// transfer data:
-			rtg.helpers.transfer_to_image(data.data(), sizeof(data[0]) * data.size(), textures.back());
+			rtg.helpers.queue_upload(data.data(), sizeof(data[0]) * data.size(), textures.back());
 		}
 	}
 
+	// send scene vertices, indices, and textures to the GPU in one batch; the graphics queue picks them up
+	//  before the first frame draws (no CPU wait here -- staging memory is freed by RTG::run as uploads finish):
+	rtg.helpers.submit_uploads();
+
 	{ // make image views for the textures
 		texture_views.reserve(textures.size());
 		for (Helpers::AllocatedImage const &image : textures)
@@ -679,6 +1002,22 @@ Tutorial::~Tutorial()
 
 	rtg.helpers.destroy_buffer(std::move(object_vertices));
 	rtg.helpers.destroy_buffer(std::move(scene_vertices));
+	if (scene_indices.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(scene_indices));
+	}
+	if (scene_transform_levels.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(scene_transform_levels));
+	}
+	if (scene_cull_objects.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(scene_cull_objects));
+	}
+	if (scene_cull_visibility.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(scene_cull_visibility));
+	}
 
 	if (swapchain_depth_image.handle != VK_NULL_HANDLE)
 	{
@@ -689,6 +1028,15 @@ Tutorial::~Tutorial()
 	lines_pipeline.destroy(rtg);
 	objects_pipeline.destroy(rtg);
 	scenes_pipeline.destroy(rtg);
+	transforms_pipeline.destroy(rtg);
+	cull_pipeline.destroy(rtg);
+	depth_pyramid_pipeline.destroy(rtg);
+
+	if (depth_pyramid_sampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(rtg.device, depth_pyramid_sampler, nullptr);
+		depth_pyramid_sampler = VK_NULL_HANDLE;
+	}
 
 	for (Workspace &workspace : workspaces)
 	{
@@ -698,62 +1046,11 @@ Tutorial::~Tutorial()
 			workspace.command_buffer = VK_NULL_HANDLE;
 		}
 
-		if (workspace.lines_vertices_src.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices_src));
-		}
-		if (workspace.lines_vertices.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices));
-		}
-
-		if (workspace.Camera_src.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Camera_src));
-		}
-		if (workspace.Camera.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Camera));
-		}
-		// Camera_descriptors freed when pool is destroyed.
-
-		if (workspace.World_src.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.World_src));
-		}
-		if (workspace.World.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.World));
-		}
-		// World_descriptors freed when pool is destroyed.
-
-		if (workspace.Transforms_src.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Transforms_src));
-		}
-		if (workspace.Transforms.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
-		}
-
-		if (workspace.Scene_world_src.handle != VK_NULL_HANDLE)
+		if (workspace.frame_data.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Scene_world_src));
+			rtg.helpers.destroy_buffer(std::move(workspace.frame_data));
 		}
-		if (workspace.Scene_world.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Scene_world));
-		}
-
-		if (workspace.Scene_transforms_src.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Scene_transforms_src));
-		}
-		if (workspace.Scene_transforms.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Scene_transforms));
-		}
-		// Transforms_descriptors freed when pool is destroyed.
+		// Camera_descriptors, World_descriptors, Transforms_descriptors, etc. freed when pool is destroyed.
 	}
 	workspaces.clear();
 
@@ -776,6 +1073,12 @@ Tutorial::~Tutorial()
 		vkDestroyRenderPass(rtg.device, render_pass, nullptr);
 		render_pass = VK_NULL_HANDLE;
 	}
+
+	if (occluder_render_pass != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(rtg.device, occluder_render_pass, nullptr);
+		occluder_render_pass = VK_NULL_HANDLE;
+	}
 }
 
 void Tutorial::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain)
@@ -791,7 +1094,7 @@ void Tutorial::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain)
 		swapchain.extent,
 		depth_format,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (rtg.configuration.cull_mode == HIZ ? VK_IMAGE_USAGE_SAMPLED_BIT : 0), // (sampled for the depth pyramid)
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		Helpers::Unmapped);
 
@@ -833,6 +1136,112 @@ void Tutorial::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain)
 		VK(vkCreateFramebuffer(rtg.device, &create_info, nullptr, &swapchain_framebuffers[i]));
 	}
 
+	if (rtg.configuration.cull_mode == HIZ)
+	{ // depth pyramid for the new depth image: mip 0 is half its size (rounding up), then mips halve down to 1x1
+		VkExtent2D extent{
+			.width = (swapchain.extent.width + 1) / 2,
+			.height = (swapchain.extent.height + 1) / 2,
+		};
+		uint32_t levels = 1;
+		while ((extent.width >> (levels - 1)) > 1 || (extent.height >> (levels - 1)) > 1)
+		{
+			++levels;
+		}
+		depth_pyramid = rtg.helpers.create_image(
+			extent,
+			VK_FORMAT_R32_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // written by depth_pyramid_pipeline, read by it and cull_pipeline
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped,
+			levels);
+
+		auto make_view = [&](uint32_t base, uint32_t count) -> VkImageView
+		{
+			VkImageViewCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.image = depth_pyramid.handle,
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.format = depth_pyramid.format,
+				.subresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = base,
+					.levelCount = count,
+					.baseArrayLayer = 0,
+					.layerCount = 1},
+			};
+			VkImageView view = VK_NULL_HANDLE;
+			VK(vkCreateImageView(rtg.device, &create_info, nullptr, &view));
+			return view;
+		};
+		depth_pyramid_view = make_view(0, levels);
+		depth_pyramid_level_views.clear();
+		for (uint32_t l = 0; l < levels; ++l)
+		{
+			depth_pyramid_level_views.emplace_back(make_view(l, 1));
+		}
+
+		{ // one set per level, reading the depth image (level 0) or the level before:
+			std::array<VkDescriptorPoolSize, 2> pool_sizes{
+				VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = levels},
+				VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = levels},
+			};
+			VkDescriptorPoolCreateInfo create_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+				.flags = 0,
+				.maxSets = levels,
+				.poolSizeCount = uint32_t(pool_sizes.size()),
+				.pPoolSizes = pool_sizes.data(),
+			};
+			VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &depth_pyramid_descriptor_pool));
+
+			std::vector<VkDescriptorSetLayout> layouts(levels, depth_pyramid_pipeline.set0_Level);
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = depth_pyramid_descriptor_pool,
+				.descriptorSetCount = levels,
+				.pSetLayouts = layouts.data(),
+			};
+			depth_pyramid_descriptors.assign(levels, VK_NULL_HANDLE);
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, depth_pyramid_descriptors.data()));
+		}
+
+		// (the pyramid stays in GENERAL layout; the depth image is read in the layout occluder_render_pass leaves it in)
+		std::vector<VkDescriptorImageInfo> infos;
+		infos.reserve(2 * levels + workspaces.size());
+		std::vector<VkWriteDescriptorSet> writes;
+		auto write = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout)
+		{
+			infos.emplace_back(VkDescriptorImageInfo{
+				.sampler = (type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ? depth_pyramid_sampler : VK_NULL_HANDLE),
+				.imageView = view,
+				.imageLayout = layout,
+			});
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = set,
+				.dstBinding = binding,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = type,
+				.pImageInfo = &infos.back(),
+			});
+		};
+		for (uint32_t l = 0; l < levels; ++l)
+		{
+			if (l == 0)
+				write(depth_pyramid_descriptors[l], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, swapchain_depth_image_view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			else
+				write(depth_pyramid_descriptors[l], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depth_pyramid_level_views[l - 1], VK_IMAGE_LAYOUT_GENERAL);
+			write(depth_pyramid_descriptors[l], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, depth_pyramid_level_views[l], VK_IMAGE_LAYOUT_GENERAL);
+		}
+		for (Workspace &workspace : workspaces)
+		{
+			write(workspace.Scene_cull_descriptors, 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depth_pyramid_view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+		vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+	}
+
 	if (rtg.configuration.debug)
 	{
 		printf("swapchain images #: %zd\n", swapchain.image_views.size());
@@ -856,6 +1265,150 @@ void Tutorial::destroy_framebuffers()
 	swapchain_depth_image_view = VK_NULL_HANDLE;
 
 	rtg.helpers.destroy_image(std::move(swapchain_depth_image));
+
+	// (the depth pyramid is sized to match the depth image)
+	if (depth_pyramid.handle != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(rtg.device, depth_pyramid_descriptor_pool, nullptr);
+		depth_pyramid_descriptor_pool = VK_NULL_HANDLE;
+		depth_pyramid_descriptors.clear(); // (freed with the pool)
+
+		for (VkImageView &view : depth_pyramid_level_views)
+		{
+			vkDestroyImageView(rtg.device, view, nullptr);
+		}
+		depth_pyramid_level_views.clear();
+		vkDestroyImageView(rtg.device, depth_pyramid_view, nullptr);
+		depth_pyramid_view = VK_NULL_HANDLE;
+
+		rtg.helpers.destroy_image(std::move(depth_pyramid));
+	}
+}
+
+void Tutorial::update_frame_data(Workspace &workspace, VkDeviceSize lines_bytes, VkDeviceSize transforms_bytes, VkDeviceSize scene_transforms_bytes, VkDeviceSize scene_instance_nodes_bytes)
+{
+	// (the per-node ranges only exist for transforms_pipeline, and are sized for the whole hierarchy)
+	VkDeviceSize node_count = rtg.configuration.gpu_transforms ? s72_scene.hierarchy.nodes.size() : 0;
+	VkDeviceSize scene_locals_bytes = node_count * sizeof(TransformsPipeline::Local);
+	VkDeviceSize scene_worlds_bytes = node_count * sizeof(mat4);
+	// (likewise the draw ranges only exist for cull_pipeline, and are sized for every scene object)
+	bool gpu_cull = rtg.configuration.gpu_culling();
+	VkDeviceSize scene_draw_commands_bytes = gpu_cull ? cull_phases() * scene_objects.size() * CullPipeline::CommandStride : 0;
+	VkDeviceSize scene_draw_counts_bytes = gpu_cull ? cull_phases() * CullPipeline::DrawKinds * sizeof(uint32_t) : 0;
+
+	if (workspace.frame_data.handle != VK_NULL_HANDLE
+		&& workspace.lines_vertices.size >= lines_bytes
+		&& workspace.Transforms.size >= transforms_bytes
+		&& workspace.Scene_transforms.size >= scene_transforms_bytes
+		&& workspace.Scene_locals.size >= scene_locals_bytes
+		&& workspace.Scene_worlds.size >= scene_worlds_bytes
+		&& workspace.Scene_instance_nodes.size >= scene_instance_nodes_bytes
+		&& workspace.Scene_draw_commands.size >= scene_draw_commands_bytes
+		&& workspace.Scene_draw_counts.size >= scene_draw_counts_bytes)
+	{
+		return;
+	}
+
+	// round to next multiple of 4k to avoid re-allocating continuously if counts grow slowly:
+	auto grow = [](VkDeviceSize have, VkDeviceSize need) -> VkDeviceSize
+	{
+		if (need <= have)
+			return have;
+		return ((need + 4096) / 4096) * 4096;
+	};
+
+	// lay out ranges back-to-back, each starting at an aligned offset:
+	VkDeviceSize total = 0;
+	auto place = [&](Workspace::Range &range, VkDeviceSize size)
+	{
+		range.offset = total;
+		range.size = size;
+		total += (size + frame_data_alignment - 1) / frame_data_alignment * frame_data_alignment;
+	};
+
+	place(workspace.Scene_world, sizeof(ScenesPipeline::World));
+	place(workspace.Scene_transforms, grow(workspace.Scene_transforms.size, scene_transforms_bytes));
+	place(workspace.Scene_locals, scene_locals_bytes);
+	place(workspace.Scene_worlds, scene_worlds_bytes);
+	place(workspace.Scene_instance_nodes, grow(workspace.Scene_instance_nodes.size, scene_instance_nodes_bytes));
+	place(workspace.Scene_draw_commands, scene_draw_commands_bytes);
+	place(workspace.Scene_draw_counts, scene_draw_counts_bytes);
+	if (!rtg.configuration.headless)
+	{
+		place(workspace.Camera, sizeof(LinesPipeline::Camera));
+		place(workspace.World, sizeof(ObjectsPipeline::World));
+		place(workspace.lines_vertices, grow(workspace.lines_vertices.size, lines_bytes));
+		place(workspace.Transforms, grow(workspace.Transforms.size, transforms_bytes));
+	}
+
+	// (the workspace's previous frame has finished, so nothing is still reading the old buffer)
+	if (workspace.frame_data.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(workspace.frame_data));
+	}
+	workspace.frame_data = rtg.helpers.create_buffer(
+		total,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // uniforms, transforms, lines vertices, and draws; filled by GPU copy
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,																																	 // GPU-local memory
+		Helpers::Unmapped																																						 // don't get a pointer to the memory
+	);
+
+	{ // point the descriptor sets at their ranges:
+		std::array<VkDescriptorBufferInfo, 13> infos{};
+		std::vector<VkWriteDescriptorSet> writes;
+
+		auto write = [&](VkDescriptorSet set, VkDescriptorType type, Workspace::Range const &range, uint32_t binding = 0)
+		{
+			if (range.size == 0)
+				return; // (nothing to point at until the first frame that needs it)
+			VkDescriptorBufferInfo &info = infos.at(writes.size());
+			info = VkDescriptorBufferInfo{
+				.buffer = workspace.frame_data.handle,
+				.offset = range.offset,
+				.range = range.size,
+			};
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = set,
+				.dstBinding = binding,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = type,
+				.pBufferInfo = &info,
+			});
+		};
+
+		if (!rtg.configuration.headless)
+		{
+			write(workspace.Camera_descriptors, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, workspace.Camera);
+			write(workspace.World_descriptors, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, workspace.World);
+			write(workspace.Transforms_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Transforms);
+		}
+		write(workspace.Scene_world_descriptors, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, workspace.Scene_world);
+		write(workspace.Scene_transforms_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_transforms);
+		if (rtg.configuration.gpu_transforms)
+		{ // (binding 1, the levels, is written once the scene is loaded)
+			write(workspace.Scene_nodes_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_locals, 0);
+			write(workspace.Scene_nodes_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_worlds, 2);
+			write(workspace.Scene_nodes_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_instance_nodes, 3);
+			write(workspace.Scene_nodes_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_transforms, 4);
+		}
+		if (gpu_cull)
+		{ // (binding 0, the objects, is written once the scene is loaded)
+			write(workspace.Scene_cull_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_worlds, 1);
+			write(workspace.Scene_cull_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_transforms, 2);
+			write(workspace.Scene_cull_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_draw_commands, 3);
+			write(workspace.Scene_cull_descriptors, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, workspace.Scene_draw_counts, 4);
+		}
+
+		vkUpdateDescriptorSets(
+			rtg.device,
+			uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
+			0, nullptr								// descriptorCopies count, data
+		);
+	}
+
+	std::cout << "Re-allocated frame data buffer to " << total << " bytes." << std::endl;
 }
 
 void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
@@ -875,6 +1428,7 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 
 	// get more convenient names for the current workspace and target framebuffer:
 	Workspace &workspace = workspaces[render_params.workspace_index];
+	bool gpu_cull = rtg.configuration.gpu_culling(); // (scene draws come from cull_pipeline, not scene_instances)
 	[[maybe_unused]] VkFramebuffer framebuffer = nullptr;
 
 	if (!rtg.configuration.headless)
@@ -909,286 +1463,317 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		VK(vkBeginCommandBuffer(workspace.command_buffer, &begin_info));
 	}
 
-	if (!rtg.configuration.headless)
-	{
-		if (!lines_vertices.empty())
-		{ // upload lines vertices:
-			//[re-]allocate lines buffers if needed:
-			size_t needed_bytes = lines_vertices.size() * sizeof(lines_vertices[0]);
-			if (workspace.lines_vertices_src.handle == VK_NULL_HANDLE || workspace.lines_vertices_src.size < needed_bytes)
-			{
-				// round to next multiple of 4k to avoid re-allocating continuously if vertex count grows slowly:
-				size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096;
+	{ // stream per-frame data: stage it all in the staging ring, then copy into frame_data with one vkCmdCopyBuffer:
+		VkDeviceSize lines_bytes = rtg.configuration.headless ? 0 : lines_vertices.size() * sizeof(lines_vertices[0]);
+		VkDeviceSize transforms_bytes = rtg.configuration.headless ? 0 : object_instances.size() * sizeof(ObjectsPipeline::Transform);
+		// (with `--culling gpu`, cull_pipeline writes a Transform for every scene object it finds visible)
+		VkDeviceSize scene_transforms_bytes = (gpu_cull ? scene_objects.size() : scene_instances.size()) * sizeof(ScenesPipeline::Transform);
+		VkDeviceSize scene_instance_nodes_bytes = rtg.configuration.gpu_transforms ? scene_instances.size() * sizeof(uint32_t) : 0;
 
-				if (workspace.lines_vertices_src.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices_src));
-				}
-				if (workspace.lines_vertices.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices));
-				}
+		//[re-]allocate frame_data if needed:
+		update_frame_data(workspace, lines_bytes, transforms_bytes, scene_transforms_bytes, scene_instance_nodes_bytes);
 
-				workspace.lines_vertices_src = rtg.helpers.create_buffer(
-					new_bytes,
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-					Helpers::Mapped																// get a pointer to the memory
-				);
-				workspace.lines_vertices = rtg.helpers.create_buffer(
-					new_bytes,
-					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as vertex buffer, also going to have GPU into this memory
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								  // GPU-local memory
-					Helpers::Unmapped													  // don't get a pointer to the memory
-				);
+		// (every range is aligned to at least Helpers::StagingAlignment, so frame_data.size bounds what is staged)
+		rtg.helpers.begin_frame_uploads(render_params.workspace_index, workspace.frame_data.size);
 
-				std::cout << render_params.workspace_index
-						  << ": Re-allocated lines buffers to " << new_bytes << " bytes." << std::endl;
+		if (!rtg.configuration.headless)
+		{
+			if (lines_bytes != 0)
+			{ // upload lines vertices:
+				rtg.helpers.stage(lines_vertices.data(), lines_bytes, workspace.lines_vertices.offset);
 			}
 
-			assert(workspace.lines_vertices_src.size == workspace.lines_vertices.size);
-			assert(workspace.lines_vertices_src.size >= needed_bytes);
+			{ // upload camera info:
+				LinesPipeline::Camera camera{
+					.CLIP_FROM_WORLD = CLIP_FROM_WORLD};
+				assert(workspace.Camera.size == sizeof(camera));
+				rtg.helpers.stage(&camera, sizeof(camera), workspace.Camera.offset);
+			}
 
-			// host-side copy into lines_vertices_src:
-			assert(workspace.lines_vertices_src.allocation.mapped);
-			std::memcpy(workspace.lines_vertices_src.allocation.data(), lines_vertices.data(), needed_bytes);
+			{ // upload world info:
+				assert(workspace.World.size == sizeof(world));
+				rtg.helpers.stage(&world, sizeof(world), workspace.World.offset);
+			}
 
-			// device-side copy from lines_vertices_src -> lines_vertices:
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = needed_bytes,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.lines_vertices_src.handle, workspace.lines_vertices.handle, 1, &copy_region);
+			if (transforms_bytes != 0)
+			{ // upload object transforms, written straight into the staging ring:
+				ObjectsPipeline::Transform *out = reinterpret_cast<ObjectsPipeline::Transform *>(rtg.helpers.stage(transforms_bytes, workspace.Transforms.offset)); // Strict aliasing violation, but it doesn't matter
+				for (ObjectInstance const &inst : object_instances)
+				{
+					*out = inst.transform;
+					++out;
+				}
+			}
 		}
 
-		{ // upload camera info:
-			LinesPipeline::Camera camera{
-				.CLIP_FROM_WORLD = CLIP_FROM_WORLD};
-			assert(workspace.Camera_src.size == sizeof(camera));
+		{ // upload scene world info:
+			assert(workspace.Scene_world.size == sizeof(world));
+			rtg.helpers.stage(&world, sizeof(world), workspace.Scene_world.offset);
+		}
 
-			// host-side copy into Camera_src:
-			memcpy(workspace.Camera_src.allocation.data(), &camera, sizeof(camera));
+		if (scene_transforms_bytes != 0 && rtg.configuration.gpu_transforms)
+		{ // upload local transforms and instance nodes; transforms_pipeline computes the scene transforms from them:
+			std::vector<NodeTRS> const &local = s72_scene.hierarchy.local;
+			TransformsPipeline::Local *out = reinterpret_cast<TransformsPipeline::Local *>(rtg.helpers.stage(workspace.Scene_locals.size, workspace.Scene_locals.offset));
+			for (size_t i = 0; i < local.size(); ++i)
+			{
+				out[i] = TransformsPipeline::Local{
+					.position{local[i].position.x, local[i].position.y, local[i].position.z, 0.0f},
+					.rotation{local[i].rotation.x, local[i].rotation.y, local[i].rotation.z, local[i].rotation.w},
+					.scale{local[i].scale.x, local[i].scale.y, local[i].scale.z, 0.0f},
+				};
+			}
 
-			// add device-side copy from Camera_src -> Camera:
-			assert(workspace.Camera_src.size == workspace.Camera.size);
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = workspace.Camera_src.size,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.Camera_src.handle, workspace.Camera.handle, 1, &copy_region);
+			if (scene_instance_nodes_bytes != 0)
+			{
+				uint32_t *nodes = reinterpret_cast<uint32_t *>(rtg.helpers.stage(scene_instance_nodes_bytes, workspace.Scene_instance_nodes.offset));
+				for (ScenesObjectInstance const &inst : scene_instances)
+				{
+					*nodes = inst.node_index;
+					++nodes;
+				}
+			}
+		}
+		else if (scene_transforms_bytes != 0)
+		{ // upload scene transforms:
+			ScenesPipeline::Transform *out = reinterpret_cast<ScenesPipeline::Transform *>(rtg.helpers.stage(scene_transforms_bytes, workspace.Scene_transforms.offset)); // Strict aliasing violation, but it doesn't matter
+			for (ScenesObjectInstance const &inst : scene_instances)
+			{
+				*out = inst.transform;
+				++out;
+			}
 		}
 
-		{ // upload world info:
-			assert(workspace.Camera_src.size == sizeof(world));
-
-			// host-side copy into World_src:
-			memcpy(workspace.World_src.allocation.data(), &world, sizeof(world));
+		// device-side copy of every staged range -> frame_data:
+		rtg.helpers.record_frame_uploads(workspace.command_buffer, workspace.frame_data);
 
-			// add device-side copy from World_src -> World:
-			assert(workspace.World_src.size == workspace.World.size);
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = workspace.World_src.size,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.World_src.handle, workspace.World.handle, 1, &copy_region);
+		if (gpu_cull)
+		{ // cull_pipeline counts visible draws from zero:
+			vkCmdFillBuffer(workspace.command_buffer, workspace.frame_data.handle, workspace.Scene_draw_counts.offset, workspace.Scene_draw_counts.size, 0);
 		}
+	}
 
-		{ // upload scene world info:
-			assert(workspace.Scene_world_src.size == sizeof(world));
-
-			// host-side copy into World_src:
-			memcpy(workspace.Scene_world_src.allocation.data(), &world, sizeof(world));
+	{ // memory barrier to make sure copies complete before rendering happens:
+		VkMemoryBarrier memory_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+		};
 
-			// add device-side copy from World_src -> World:
-			assert(workspace.Scene_world_src.size == workspace.Scene_world.size);
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = workspace.Scene_world_src.size,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.Scene_world_src.handle, workspace.Scene_world.handle, 1, &copy_region);
+		VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		if (rtg.configuration.gpu_transforms)
+		{
+			dst_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT; // (local transforms and instance nodes; zeroed draw counts)
 		}
 
-		if (!object_instances.empty())
-		{ // upload object transforms:
-			//[re-]allocate lines buffers if needed:
-			size_t needed_bytes = object_instances.size() * sizeof(ObjectsPipeline::Transform);
-			if (workspace.Transforms_src.handle == VK_NULL_HANDLE || workspace.Transforms_src.size < needed_bytes)
-			{
-				// round to next multiple of 4k to avoid re-allocating continuously if vertex count grows slowly:
-				size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096;
-
-				if (workspace.Transforms_src.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.Transforms_src));
-				}
-				if (workspace.Transforms.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
-				}
+		vkCmdPipelineBarrier(workspace.command_buffer,
+							 VK_PIPELINE_STAGE_TRANSFER_BIT,	   // srcStageMask
+							 dst_stages,						   // dstStageMask (lines vertices, uniforms, transforms)
+							 0,									   // dependencyFlags
+							 1, &memory_barrier,				   // memoryBarriers (count, data)
+							 0, nullptr,						   // bufferMemoryBarriers (count, data)
+							 0, nullptr							   // imageMemoryBarriers (count, data)
+		);
+	}
 
-				workspace.Transforms_src = rtg.helpers.create_buffer(
-					new_bytes,
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-					Helpers::Mapped																// get a pointer to the memory
-				);
-				workspace.Transforms = rtg.helpers.create_buffer(
-					new_bytes,
-					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as vertex buffer, also going to have GPU into this memory
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU-local memory
-					Helpers::Unmapped													   // don't get a pointer to the memory
-				);
+	// (culling on the GPU) one indirect call per draw kind, over the commands a cull_pipeline phase wrote:
+	auto draw_culled = [&](uint32_t phase)
+	{
+		uint32_t const stride = CullPipeline::CommandStride;
+		for (uint32_t kind = 0; kind < CullPipeline::DrawKinds; ++kind)
+		{
+			if (scene_draw_counts[kind] == 0)
+				continue;
+			VkDeviceSize commands = workspace.Scene_draw_commands.offset + (VkDeviceSize(phase) * scene_objects.size() + scene_draw_firsts[kind]) * stride;
+			VkDeviceSize count = workspace.Scene_draw_counts.offset + (phase * CullPipeline::DrawKinds + kind) * sizeof(uint32_t);
+			if (kind == CullPipeline::Unindexed)
+			{
+				if (rtg.draw_indirect_count)
+					vkCmdDrawIndirectCount(workspace.command_buffer, workspace.frame_data.handle, commands, workspace.frame_data.handle, count, scene_draw_counts[kind], stride);
+				else
+					vkCmdDrawIndirect(workspace.command_buffer, workspace.frame_data.handle, commands, scene_draw_counts[kind], stride);
+				continue;
+			}
+			// (scene_instances is empty when culling on the GPU, so nothing else tracks the bound index type)
+			vkCmdBindIndexBuffer(workspace.command_buffer, scene_indices.handle, 0, (kind == CullPipeline::Indexed16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32));
+			if (rtg.draw_indirect_count)
+				vkCmdDrawIndexedIndirectCount(workspace.command_buffer, workspace.frame_data.handle, commands, workspace.frame_data.handle, count, scene_draw_counts[kind], stride);
+			else
+				vkCmdDrawIndexedIndirect(workspace.command_buffer, workspace.frame_data.handle, commands, scene_draw_counts[kind], stride);
+		}
+	};
 
-				// update the descriptor set:
-				VkDescriptorBufferInfo Transforms_info{
-					.buffer = workspace.Transforms.handle,
-					.offset = 0,
-					.range = workspace.Transforms.size,
-				};
+	// (culling on the GPU) run one cull_pipeline phase, then make its draws visible to the draw commands that follow:
+	auto dispatch_cull = [&](uint32_t phase)
+	{
+		vkCmdBindDescriptorSets(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline.layout, 0, 1, &workspace.Scene_cull_descriptors, 0, nullptr);
+		vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline.handle);
+
+		CullPipeline::Push push{
+			.count = uint32_t(scene_objects.size()),
+			.phase = phase,
+			.first_command = phase * uint32_t(scene_objects.size()),
+			.first_count = phase * CullPipeline::DrawKinds,
+			.width = rtg.swapchain_extent.width,
+			.height = rtg.swapchain_extent.height,
+		};
+		std::memcpy(push.CLIP_FROM_WORLD.data(), glm::value_ptr(scene_clip_from_world), sizeof(float) * 16);
+		vkCmdPushConstants(workspace.command_buffer, cull_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(workspace.command_buffer, (push.count + CullPipeline::GroupSize - 1) / CullPipeline::GroupSize, 1, 1);
 
-				std::array<VkWriteDescriptorSet, 1> writes{
-					VkWriteDescriptorSet{
-						.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-						.dstSet = workspace.Transforms_descriptors,
-						.dstBinding = 0,
-						.dstArrayElement = 0,
-						.descriptorCount = 1,
-						.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-						.pBufferInfo = &Transforms_info,
-					},
-				};
+		// the indirect draws read the commands and counts; the scene pipelines' vertex shaders read the Transforms
+		//  (and the last phase's draws overwrite depth that the pyramid build read):
+		VkMemoryBarrier draw_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+		};
+		VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+		if (phase != 0)
+		{
+			dst_stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		}
+		vkCmdPipelineBarrier(workspace.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0, 1, &draw_barrier, 0, nullptr, 0, nullptr);
+	};
 
-				vkUpdateDescriptorSets(
-					rtg.device,
-					uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
-					0, nullptr								// descriptorCopies count, data
-				);
+	if (rtg.configuration.gpu_transforms && (gpu_cull ? !scene_objects.empty() : !scene_instances.empty()))
+	{ // compute scene transforms: world transforms one level at a time, then every instance's Transform (or, culling on the GPU, every visible object's Transform and draw):
+		vkCmdBindDescriptorSets(
+			workspace.command_buffer,				 // command buffer
+			VK_PIPELINE_BIND_POINT_COMPUTE,			 // pipeline bind point
+			transforms_pipeline.layout,				 // pipeline layout
+			0,										 // first set
+			1, &workspace.Scene_nodes_descriptors, // descriptor sets count, ptr
+			0, nullptr								 // dynamic offsets count, ptr
+		);
 
-				std::cout << "Re-allocated object transforms buffers to " << new_bytes << " bytes." << std::endl;
-			}
+		TransformsPipeline::Push push{};
+		std::memcpy(push.CLIP_FROM_WORLD.data(), glm::value_ptr(scene_clip_from_world), sizeof(float) * 16);
 
-			assert(workspace.Transforms_src.size == workspace.Transforms.size);
-			assert(workspace.Transforms_src.size >= needed_bytes);
+		// each dispatch's writes are read by the next one (children read their parents' worlds; instances read every world):
+		VkMemoryBarrier compute_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		};
 
-			{ // copy transforms into Transforms_src:
-				assert(workspace.Transforms_src.allocation.mapped);
-				ObjectsPipeline::Transform *out = reinterpret_cast<ObjectsPipeline::Transform *>(workspace.Transforms_src.allocation.data()); // Strict aliasing violation, but it doesn't matter
-				for (ObjectInstance const &inst : object_instances)
-				{
-					*out = inst.transform;
-					++out;
-				}
-			}
+		vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, transforms_pipeline.handle);
+		for (size_t l = 0; l + 1 < transform_level_starts.size(); ++l)
+		{
+			push.first = transform_level_starts[l];
+			push.count = transform_level_starts[l + 1] - transform_level_starts[l];
+			vkCmdPushConstants(workspace.command_buffer, transforms_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+			vkCmdDispatch(workspace.command_buffer, (push.count + TransformsPipeline::GroupSize - 1) / TransformsPipeline::GroupSize, 1, 1);
+			vkCmdPipelineBarrier(workspace.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+		}
 
-			// device-side copy from lines_vertices_src -> lines_vertices:
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = needed_bytes,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.Transforms_src.handle, workspace.Transforms.handle, 1, &copy_region);
+		if (gpu_cull)
+		{ // test every object against the frustum; write the visible ones' Transforms and draw commands
+			//  (with `--culling hiz`, just the ones visible last frame; the rest wait for the depth pyramid, below):
+			// (the level barriers above also order this after the last frame's reads and writes of the visibility buffer)
+			dispatch_cull(0);
 		}
-	}
-	if (!scene_instances.empty())
-	{ // upload scene transforms:
-		//[re-]allocate lines buffers if needed:
-		size_t needed_bytes = scene_instances.size() * sizeof(ScenesPipeline::Transform);
-		if (workspace.Scene_transforms_src.handle == VK_NULL_HANDLE || workspace.Scene_transforms_src.size < needed_bytes)
+		else
 		{
-			// round to next multiple of 4k to avoid re-allocating continuously if vertex count grows slowly:
-			size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096;
-
-			if (workspace.Scene_transforms_src.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.Scene_transforms_src));
-			}
-			if (workspace.Scene_transforms.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.Scene_transforms));
-			}
+			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, transforms_pipeline.instances);
+			push.first = 0;
+			push.count = uint32_t(scene_instances.size());
+			vkCmdPushConstants(workspace.command_buffer, transforms_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+			vkCmdDispatch(workspace.command_buffer, (push.count + TransformsPipeline::GroupSize - 1) / TransformsPipeline::GroupSize, 1, 1);
+
+			// the scene pipelines' vertex shaders read the Transforms:
+			vkCmdPipelineBarrier(workspace.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+		}
+	}
 
-			workspace.Scene_transforms_src = rtg.helpers.create_buffer(
-				new_bytes,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// get a pointer to the memory
-			);
-			workspace.Scene_transforms = rtg.helpers.create_buffer(
-				new_bytes,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as vertex buffer, also going to have GPU into this memory
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // GPU-local memory
-				Helpers::Unmapped													   // don't get a pointer to the memory
-			);
-
-			// update the descriptor set:
-			VkDescriptorBufferInfo Transforms_info{
-				.buffer = workspace.Scene_transforms.handle,
-				.offset = 0,
-				.range = workspace.Scene_transforms.size,
+	if (rtg.configuration.cull_mode == HIZ && !scene_objects.empty())
+	{ // occlusion culling: lay down the depth of last frame's visible objects, reduce it to the depth pyramid, and cull every object against that
+		{ // depth of the first phase's draws:
+			std::array<VkClearValue, 2> clear_values{
+				VkClearValue{.color{.float32{0.f, 0.f, 0.f, 1.0f}}}, // (not used; color isn't loaded)
+				VkClearValue{.depthStencil{.depth = 1.0f, .stencil = 0}},
 			};
-
-			std::array<VkWriteDescriptorSet, 1> writes{
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.Scene_transforms_descriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &Transforms_info,
+			VkRenderPassBeginInfo begin_info{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = occluder_render_pass,
+				.framebuffer = framebuffer,
+				.renderArea{
+					.offset = {.x = 0, .y = 0},
+					.extent = rtg.swapchain_extent,
 				},
+				.clearValueCount = uint32_t(clear_values.size()),
+				.pClearValues = clear_values.data(),
+			};
+			vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkRect2D scissor{
+				.offset = {.x = 0, .y = 0},
+				.extent = rtg.swapchain_extent,
+			};
+			vkCmdSetScissor(workspace.command_buffer, 0, 1, &scissor);
+			VkViewport viewport{
+				.x = 0.0f,
+				.y = 0.0f,
+				.width = float(rtg.swapchain_extent.width),
+				.height = float(rtg.swapchain_extent.height),
+				.minDepth = 0.0f,
+				.maxDepth = 1.0f,
 			};
+			vkCmdSetViewport(workspace.command_buffer, 0, 1, &viewport);
 
-			vkUpdateDescriptorSets(
-				rtg.device,
-				uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
-				0, nullptr								// descriptorCopies count, data
-			);
+			std::array<VkDescriptorSet, 2> descriptor_sets{
+				workspace.Scene_world_descriptors,		// 0: World
+				workspace.Scene_transforms_descriptors, // 1: Transforms
+			};
+			vkCmdBindDescriptorSets(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.layout, 0, uint32_t(descriptor_sets.size()), descriptor_sets.data(), 0, nullptr);
+			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.depth_only);
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(workspace.command_buffer, 0, 1, &scene_vertices.handle, &offset);
+
+			draw_culled(0);
 
-			std::cout << "Re-allocated scene transforms buffers to " << new_bytes << " bytes." << std::endl;
+			vkCmdEndRenderPass(workspace.command_buffer);
 		}
 
-		assert(workspace.Scene_transforms_src.size == workspace.Scene_transforms.size);
-		assert(workspace.Scene_transforms_src.size >= needed_bytes);
+		{ // build the pyramid one level at a time (the render pass's outgoing dependency makes depth readable):
+			VkImageMemoryBarrier start_barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED, // (rebuilt every frame; also waits for the last frame's reads)
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = depth_pyramid.handle,
+				.subresourceRange{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = 0,
+					.levelCount = depth_pyramid.mip_levels,
+					.baseArrayLayer = 0,
+					.layerCount = 1},
+			};
+			vkCmdPipelineBarrier(workspace.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &start_barrier);
+
+			// each level is read by the next (and the last by the cull):
+			VkMemoryBarrier level_barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			};
 
-		{ // copy transforms into Transforms_src:
-			assert(workspace.Scene_transforms_src.allocation.mapped);
-			ScenesPipeline::Transform *out = reinterpret_cast<ScenesPipeline::Transform *>(workspace.Scene_transforms_src.allocation.data()); // Strict aliasing violation, but it doesn't matter
-			for (ScenesObjectInstance const &inst : scene_instances)
+			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, depth_pyramid_pipeline.handle);
+			for (uint32_t l = 0; l < depth_pyramid.mip_levels; ++l)
 			{
-				*out = inst.transform;
-				++out;
+				uint32_t width = std::max(1u, depth_pyramid.extent.width >> l);
+				uint32_t height = std::max(1u, depth_pyramid.extent.height >> l);
+				vkCmdBindDescriptorSets(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, depth_pyramid_pipeline.layout, 0, 1, &depth_pyramid_descriptors[l], 0, nullptr);
+				vkCmdDispatch(workspace.command_buffer, (width + DepthPyramidPipeline::GroupSize - 1) / DepthPyramidPipeline::GroupSize, (height + DepthPyramidPipeline::GroupSize - 1) / DepthPyramidPipeline::GroupSize, 1);
+				vkCmdPipelineBarrier(workspace.command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &level_barrier, 0, nullptr, 0, nullptr);
 			}
 		}
 
-		// device-side copy from lines_vertices_src -> lines_vertices:
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = needed_bytes,
-		};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.Scene_transforms_src.handle, workspace.Scene_transforms.handle, 1, &copy_region);
-	}
-
-	{ // memory barrier to make sure copies complete before rendering happens:
-		VkMemoryBarrier memory_barrier{
-			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
-		};
-
-		vkCmdPipelineBarrier(workspace.command_buffer,
-							 VK_PIPELINE_STAGE_TRANSFER_BIT,	 // srcStageMask
-							 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, // dstStageMask
-							 0,									 // dependencyFlags
-							 1, &memory_barrier,				 // memoryBarriers (count, data)
-							 0, nullptr,						 // bufferMemoryBarriers (count, data)
-							 0, nullptr							 // imageMemoryBarriers (count, data)
-		);
+		// every object against the frustum and the pyramid; these are the draws of the render pass below:
+		dispatch_cull(1);
 	}
 
 	// put GPU commands here!
@@ -1252,9 +1837,9 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		// { // draw with the lines pipeline:
 		// 	vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lines_pipeline.handle);
 
-		// 	{ // use lines_vertices (offset 0) as vertex buffer binding 0:
-		// 		std::array<VkBuffer, 1> vertex_buffers{workspace.lines_vertices.handle};
-		// 		std::array<VkDeviceSize, 1> offsets{0};
+		// 	{ // use lines_vertices (its range of frame_data) as vertex buffer binding 0:
+		// 		std::array<VkBuffer, 1> vertex_buffers{workspace.frame_data.handle};
+		// 		std::array<VkDeviceSize, 1> offsets{workspace.lines_vertices.offset};
 		// 		vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
 		// 	}
 
@@ -1325,19 +1910,11 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		}
 
 		// if (0)
-		if (!scene_instances.empty())
+		if (gpu_cull ? !scene_objects.empty() : !scene_instances.empty())
 		{ // draw with the scene pipeline:
 			// std::cout << "scene_instances #: " << scene_instances.size() << "\n";
 
-			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.handle);
-
-			{ // use object_vertices (offset 0) as vertex buffer binding 0:
-				std::array<VkBuffer, 1> vertex_buffers{scene_vertices.handle};
-				std::array<VkDeviceSize, 1> offsets{0};
-				vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
-			}
-
-			{ // bind World and Transforms descriptor sets:
+			{ // bind World and Transforms descriptor sets (shared by both scene pipelines' layout):
 				std::array<VkDescriptorSet, 2> descriptor_sets{
 					workspace.Scene_world_descriptors,		// 0: World
 					workspace.Scene_transforms_descriptors, // 1: Transforms
@@ -1352,8 +1929,61 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				);
 			}
 
+			// index buffer is (re)bound at offset 0 whenever the index type changes; meshes then start at firstIndex:
+			std::optional<VkIndexType> bound_index_type;
+
+			auto draw_instance = [&](ScenesObjectInstance const &inst, uint32_t index)
+			{
+				if (inst.vertices.index_count != 0)
+				{
+					if (bound_index_type != inst.vertices.index_type)
+					{
+						vkCmdBindIndexBuffer(workspace.command_buffer, scene_indices.handle, 0, inst.vertices.index_type);
+						bound_index_type = inst.vertices.index_type;
+					}
+					VkDeviceSize index_size = (inst.vertices.index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+					vkCmdDrawIndexed(workspace.command_buffer, inst.vertices.index_count, 1, uint32_t(inst.vertices.index_offset / index_size), int32_t(inst.vertices.first), index);
+				}
+				else
+				{
+					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				}
+			};
+
+			if (rtg.configuration.depth_prepass)
+			{ // lay down depth first, fetching only the position stream:
+				vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.depth_only);
+
+				std::array<VkBuffer, 1> vertex_buffers{scene_vertices.handle};
+				std::array<VkDeviceSize, 1> offsets{0};
+				vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+
+				if (gpu_cull)
+				{
+					draw_culled(cull_phases() - 1);
+				}
+				for (ScenesObjectInstance const &inst : scene_instances)
+				{
+					draw_instance(inst, uint32_t(&inst - &scene_instances[0]));
+				}
+			}
+
+			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.handle);
+
+			{ // use scene_vertices positions as vertex buffer binding 0 and other attributes as binding 1:
+				std::array<VkBuffer, 2> vertex_buffers{scene_vertices.handle, scene_vertices.handle};
+				std::array<VkDeviceSize, 2> offsets{0, VkDeviceSize(scene_streams.attributes_offset())};
+				vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+			}
+
 			// Camera descriptor set is still bound, but unused(!)
 
+			if (gpu_cull)
+			{ // (every scene object uses texture 0, as update() assigns)
+				vkCmdBindDescriptorSets(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenes_pipeline.layout, 2, 1, &texture_descriptors[0], 0, nullptr);
+				draw_culled(cull_phases() - 1);
+			}
+
 			// draw all instances:
 			for (ScenesObjectInstance const &inst : scene_instances)
 			{
@@ -1369,7 +1999,7 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params)
 					0, nullptr							   // dynamic offsets count, ptr
 				);
 				// std::cout << "ObjectInstance index: " << index << ", vertices count: " << inst.vertices.count << "\n";
-				vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
+				draw_instance(inst, index);
 			}
 		}
 
@@ -1629,9 +2259,7 @@ void Tutorial::update(float dt)
 	}
 
 	{ // make scene objects:
-		scene_instances.clear();
 		{
-			glm::mat4 WORLD_FROM_LOCAL(1.0f);
 			glm::mat4 CLIP_FROM_WORLD_SCENE(1.0f);
 			glm::mat4 WORLD_FROM_LOCAL_debug(1.0f);
 
@@ -1646,18 +2274,30 @@ void Tutorial::update(float dt)
 				}
 				// std::cout << "play: " << playmode.time << "\n";
 
-				for (auto &driver : s72_scene.drivers)
+				if (animation_bake.empty())
 				{
-					std::string node_name = driver.refnode_name;
-					Node *node_ = s72_scene.nodes_map[node_name];
-					driver.make_animation(playmode.time);
-					s72_scene.transforms[node_] = node_->make_local_to_world();
+					driver_batch.evaluate(playmode.time, &rtg.jobs);
+				}
+			}
 
-					node_->child_forward_kinematics_transforms(node_);
-					//   WORLD_FROM_LOCAL *= ANIMATION_MATRIX;
+			// in USER mode, change camera position:
+			if (playmode.camera_mode == USER && s72_scene.current_camera_ != nullptr)
+			{
+				if (auto found = s72_scene.nodes_map.find(s72_scene.current_camera_->name); found != s72_scene.nodes_map.end())
+				{
+					move_camera(dt, found->second);
 				}
 			}
 
+			// world transforms of the nodes animated above (and their descendants):
+			s72_scene.hierarchy.update_world(&rtg.jobs);
+			// baked nodes' locals never change, so once the animation has started, overwrite them with the bake
+			//  (every frame, since moving the user camera can recompute them from those locals):
+			if (!animation_bake.empty() && (playmode.animation_mode == PLAY || playmode.time != 0.0f))
+			{
+				animation_bake.play(playmode.time, &rtg.jobs);
+			}
+
 			if (!s72_scene.cameras.empty())
 			{
 				if (s72_scene.current_camera_ == nullptr)
@@ -1676,15 +2316,9 @@ void Tutorial::update(float dt)
 
 					Node *camera_node_ = s72_scene.nodes_map[camera_name];
 
-					// in USER mode, change camera position
-					if (playmode.camera_mode == USER)
-					{
-						move_camera(dt, camera_node_);
-					}
-
 					auto mat_perspective = mat4_perspective(vfov, aspect, near, far);
 
-					CLIP_FROM_WORLD_SCENE = mat_perspective * glm::mat4(camera_node_->make_world_to_local());
+					CLIP_FROM_WORLD_SCENE = mat_perspective * s72_scene.hierarchy.world_to_local(camera_node_->index_);
 
 					// std::cout << "make_world_to_local\n";
 					// printMat4(WORLD_FROM_LOCAL);
@@ -1697,51 +2331,103 @@ void Tutorial::update(float dt)
 				}
 			}
 
-			for (const auto &scene_object : scene_objects)
+			scene_clip_from_world = CLIP_FROM_WORLD_SCENE;
+			if (rtg.configuration.gpu_culling())
+			{ // render() has cull_pipeline test every object, write its Transform, and generate the draws:
+				scene_instances.clear();
+				return;
+			}
+			bool gpu_transforms = rtg.configuration.gpu_transforms; // (then render() has transforms_pipeline compute each Transform)
+			bool cull = (playmode.camera_mode == DEBUG || playmode.cull_mode == FRUSTUM || playmode.cull_mode == OCCLUSION);
+
+			// nodes whose world transforms changed this frame: the subtrees update_world recomputed, and the nodes the bake wrote
+			//  (merged into disjoint ranges, so each moved object is refit once):
+			NodeHierarchy const &hierarchy = s72_scene.hierarchy;
+			moved_node_ranges.clear();
+			for (uint32_t root : hierarchy.update_roots)
 			{
-				Node *node_ = scene_object.object_node_;
-
-				glm::mat4 obj_transform = s72_scene.transforms[node_];
-				// std::cout << "\nobject world from local\n";
-				// printMat4(obj_transform);
-
-				WORLD_FROM_LOCAL = obj_transform;
-
-				// culling
-				if (playmode.camera_mode == DEBUG || playmode.cull_mode == FRUSTUM) // (playmode.cull_mode == FRUSTUM)
+				moved_node_ranges.emplace_back(root, hierarchy.subtree_end[root]);
+			}
+			if (!animation_bake.empty() && (playmode.animation_mode == PLAY || playmode.time != 0.0f))
+			{
+				for (uint32_t node : animation_bake.nodes)
+				{
+					moved_node_ranges.emplace_back(node, node + 1);
+				}
+			}
+			std::sort(moved_node_ranges.begin(), moved_node_ranges.end());
+			moved_objects.clear();
+			uint32_t moved_end = 0; // nodes below this are already covered
+			for (auto [begin, end] : moved_node_ranges)
+			{
+				begin = std::max(begin, moved_end);
+				if (begin >= end)
+					continue;
+				moved_end = end;
+				auto node_less = [](SceneObject const &object, uint32_t node)
+				{ return uint32_t(object.node_index) < node; };
+				auto first = std::lower_bound(scene_objects.begin(), scene_objects.end(), begin, node_less);
+				auto last = std::lower_bound(first, scene_objects.end(), end, node_less);
+				for (auto it = first; it != last; ++it)
 				{
+					moved_objects.emplace_back(uint32_t(it - scene_objects.begin()));
+				}
+			}
 
-					auto mesh_ = node_->mesh_;
-					BBox bbox_trans = s72_scene.mesh_bbox_map[mesh_].transform(s72_scene.transforms[node_]);
-					auto planes = extract_planes(CLIP_FROM_WORLD_SCENE);
+			// place the moved objects' bounds (kept up to date even when not culling, so culling can start any frame):
+			scene_bvh.update(hierarchy.world.data(), moved_objects, &rtg.jobs);
 
-					if (bbox_trans.is_bbox_outside_frustum(planes) == true)
+			visible_objects.clear();
+			if (cull) // (playmode.cull_mode == FRUSTUM or OCCLUSION)
+			{
+				scene_bvh.cull(extract_planes(CLIP_FROM_WORLD_SCENE), &visible_objects);
+				if (playmode.cull_mode == OCCLUSION && !occlusion_buffer.empty())
+				{ // then drop the objects whose bounds are hidden behind the occluders, rasterized on the CPU:
+					occlusion_buffer.render(CLIP_FROM_WORLD_SCENE, hierarchy.world.data(), &rtg.jobs);
+					occluded_objects.resize(visible_objects.size());
+					rtg.jobs.parallel_for(visible_objects.size(), InstanceChunk, [&](size_t begin, size_t end)
+										  {
+						for (size_t i = begin; i < end; ++i)
+						{
+							uint32_t object = visible_objects[i];
+							occluded_objects[i] = occlusion_buffer.occluded(scene_bvh.world.get(scene_bvh.slot_of[object])) ? 1 : 0;
+						} });
+					size_t kept = 0;
+					for (size_t i = 0; i < visible_objects.size(); ++i)
 					{
-						continue;
+						if (!occluded_objects[i])
+							visible_objects[kept++] = visible_objects[i];
 					}
+					visible_objects.resize(kept);
 				}
+			}
+			else
+			{
+				visible_objects.resize(scene_objects.size());
+				std::iota(visible_objects.begin(), visible_objects.end(), 0u);
+			}
 
-				ScenesObjectInstance obj{
-					.vertices = scene_object.scene_object_vertices,
-					.transform{
-						// .CLIP_FROM_LOCAL = CLIP_FROM_WORLD_SCENE * WORLD_FROM_LOCAL,
-						// .WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-						// .WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL, // Assuming normal matrix is the same for simplicity
-						// .WORLD_FROM_LOCAL_TANGENT = WORLD_FROM_LOCAL,
-					},
-					.texture = 0, // Assign the appropriate texture ID if needed
-				};
-
-				// glm::mat4 obj_world_from_local = WORLD_FROM_LOCAL * glm::make_mat4(obj_transform.WORLD_FROM_LOCAL.data());
-
-				std::memcpy(obj.transform.CLIP_FROM_LOCAL.data(), glm::value_ptr(CLIP_FROM_WORLD_SCENE * WORLD_FROM_LOCAL), sizeof(float) * 16);
-				// std::memcpy(obj.transform.CLIP_FROM_LOCAL.data(), glm::value_ptr(CLIP_FROM_WORLD_SCENE * WORLD_FROM_LOCAL), sizeof(float) * 16);
-				std::memcpy(obj.transform.WORLD_FROM_LOCAL.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
-				std::memcpy(obj.transform.WORLD_FROM_LOCAL_NORMAL.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
-				std::memcpy(obj.transform.WORLD_FROM_LOCAL_TANGENT.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
+			// write the visible instances in fixed-size chunks across the job system:
+			scene_instances.resize(visible_objects.size());
+			rtg.jobs.parallel_for(visible_objects.size(), InstanceChunk, [&](size_t begin, size_t end)
+								  {
+				for (size_t i = begin; i < end; ++i)
+				{
+					SceneObject const &scene_object = scene_objects[visible_objects[i]];
+					glm::mat4 const &WORLD_FROM_LOCAL = hierarchy.world[scene_object.node_index];
+
+					ScenesObjectInstance &obj = scene_instances[i];
+					obj.vertices = scene_object.scene_object_vertices;
+					obj.node_index = uint32_t(scene_object.node_index);
+					obj.texture = 0; // Assign the appropriate texture ID if needed
+					if (gpu_transforms)
+						continue;
 
-				scene_instances.emplace_back(obj);
-			}
+					std::memcpy(obj.transform.CLIP_FROM_LOCAL.data(), glm::value_ptr(CLIP_FROM_WORLD_SCENE * WORLD_FROM_LOCAL), sizeof(float) * 16);
+					std::memcpy(obj.transform.WORLD_FROM_LOCAL.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
+					std::memcpy(obj.transform.WORLD_FROM_LOCAL_NORMAL.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
+					std::memcpy(obj.transform.WORLD_FROM_LOCAL_TANGENT.data(), glm::value_ptr(WORLD_FROM_LOCAL), sizeof(float) * 16);
+				} });
 		}
 	}
 }
@@ -1872,10 +2558,12 @@ void Tutorial::on_input(InputEvent const &evt)
 
 			// std::cout << "mouse move: " << motion.x << ", " << motion.y << "    ";
 
-			[[maybe_unused]] Node *node_ = s72_scene.nodes_map[s72_scene.current_camera_->name];
+			Node *node_ = s72_scene.nodes_map[s72_scene.current_camera_->name];
+			// (per-frame code reads the camera's transform from the hierarchy, as move_camera writes it)
+			glm::quat &rotation = s72_scene.hierarchy.local[node_->index_].rotation;
 
-			node_->rotation = glm::normalize(
-				node_->rotation * glm::angleAxis(-motion.x * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)) *
+			rotation = glm::normalize(
+				rotation * glm::angleAxis(-motion.x * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)) *
 				glm::angleAxis(motion.y * s72_scene.current_camera_->perspective.vfov, glm::vec3(1.0f, 0.0f, 0.0f)));
 
 			// update mouse cor
@@ -1887,29 +2575,31 @@ void Tutorial::on_input(InputEvent const &evt)
 			if (evt.motion.x <= edge_threshold)
 			{
 				// Mouse is near the left edge, rotate the camera left
-				node_->rotation = glm::normalize(
-					node_->rotation * glm::angleAxis(edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)));
+				rotation = glm::normalize(
+					rotation * glm::angleAxis(edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)));
 			}
 			else if (evt.motion.x >= width - edge_threshold)
 			{
 				// Mouse is near the right edge, rotate the camera right
-				node_->rotation = glm::normalize(
-					node_->rotation * glm::angleAxis(-edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)));
+				rotation = glm::normalize(
+					rotation * glm::angleAxis(-edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(0.0f, 1.0f, 0.0f)));
 			}
 
 			if (evt.motion.y <= edge_threshold)
 			{
 				// Mouse is near the top edge, rotate the camera up
-				node_->rotation = glm::normalize(
-					node_->rotation * glm::angleAxis(edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(1.0f, 0.0f, 0.0f)));
+				rotation = glm::normalize(
+					rotation * glm::angleAxis(edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(1.0f, 0.0f, 0.0f)));
 			}
 			else if (evt.motion.y >= height - edge_threshold)
 			{
 				// Mouse is near the bottom edge, rotate the camera down
-				node_->rotation = glm::normalize(
-					node_->rotation * glm::angleAxis(-edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(1.0f, 0.0f, 0.0f)));
+				rotation = glm::normalize(
+					rotation * glm::angleAxis(-edge_rotation_speed * s72_scene.current_camera_->perspective.vfov, glm::vec3(1.0f, 0.0f, 0.0f)));
 			}
 
+			s72_scene.hierarchy.mark_dirty(node_->index_);
+
 			// Update mouse coordinates
 			playmode.mouse_state.last_x = evt.motion.x;
 			playmode.mouse_state.last_y = evt.motion.y;
@@ -1939,12 +2629,17 @@ void Tutorial::move_camera(float elapsed, Node *node_)
 		if (move != glm::vec2(0.0f))
 			move = glm::normalize(move) * PlayerSpeed * elapsed;
 
-		glm::mat4x3 frame = node_->make_local_to_parent();
+		NodeTRS &local = s72_scene.hierarchy.local[node_->index_];
+		glm::mat4x3 frame = local.make_local_to_parent();
 		glm::vec3 frame_right = frame[0];
 		// glm::vec3 up = frame[1];
 		glm::vec3 frame_forward = -frame[2];
 
-		node_->position += move.x * frame_right + move.y * frame_forward;
+		if (move != glm::vec2(0.0f))
+		{
+			local.position += move.x * frame_right + move.y * frame_forward;
+			s72_scene.hierarchy.mark_dirty(node_->index_);
+		}
 	}
 
 	// reset button press counters:
@@ -1954,166 +2649,496 @@ void Tutorial::move_camera(float elapsed, Node *node_)
 	playmode.down.downs = 0;
 }
 
+uint32_t Tutorial::scene_cache_options() const
+{
+	uint32_t options = 0;
+	if (rtg.configuration.weld_vertices)
+		options |= SceneCache::Welded;
+	if (rtg.configuration.packed_vertices)
+		options |= SceneCache::Packed;
+	if (rtg.configuration.compress_animation)
+		options |= SceneCache::CompressedAnimation;
+	return options;
+}
+
+
 void Tutorial::load_s72()
 {
 	std::cout << std::filesystem::current_path() << "  load s72 file: ";
-	std::string s72_file;
-	s72_file = "./resource/" + rtg.configuration.scene_name;
+	s72_path = "./resource/" + rtg.configuration.scene_name;
 	if (rtg.configuration.headless)
 	{
-		s72_file = "./resource/sphereflake.s72"; // set default
+		s72_path = "./resource/sphereflake.s72"; // set default
+	}
+	std::cout << s72_path << "\n";
+
+	if (rtg.configuration.scene_cache && scene_cache.load(s72_path, scene_cache_options()))
+	{
+		scene_from_cache = true;
+	}
+	else
+	{
+		sejp::value val = sejp::load(s72_path);
+		scene_workflow(val);
+		if (rtg.configuration.compress_animation)
+		{
+			compress_drivers(); // (saved compressed in the scene cache, so warm starts skip this)
+		}
+	}
+
+	build_node_hierarchy();
+	driver_batch.build();
+	if (rtg.configuration.benchmark_animation)
+	{
+		driver_batch.benchmark(1000);
+	}
+	if (rtg.configuration.bake_animation_rate > 0.0f)
+	{
+		float rate = rtg.configuration.bake_animation_rate;
+		bool quantized = rtg.configuration.bake_quantized;
+		bool compressed = rtg.configuration.compress_animation;
+		if (!(rtg.configuration.scene_cache && animation_bake.load(s72_path, rate, quantized, compressed)))
+		{
+			animation_bake.bake(driver_batch, rate, quantized, &rtg.jobs);
+			if (rtg.configuration.scene_cache && !animation_bake.empty())
+			{
+				animation_bake.save(s72_path, rate, compressed);
+			}
+		}
+		std::cout << "Baked animation: " << animation_bake.nodes.size() << " nodes x " << animation_bake.frames << " frames, "
+				  << animation_bake.bytes() / 1024 << " KiB.\n";
 	}
-	std::cout << s72_file;
-	sejp::value val = sejp::load(s72_file);
-	scene_workflow(val);
 	// std::map<std::string, sejp::value> const &object = val.as_object().value();
 }
 
-void Tutorial::set_mesh_vertices_map(std::vector<SceneVertex> &vertices)
+// size in bytes of one index in the given s72 index format (0 if unsupported):
+static uint32_t index_format_size(std::string const &format, VkIndexType *type)
+{
+	if (format == "UINT32")
+	{
+		*type = VK_INDEX_TYPE_UINT32;
+		return 4;
+	}
+	if (format == "UINT16")
+	{
+		*type = VK_INDEX_TYPE_UINT16;
+		return 2;
+	}
+	return 0;
+}
+
+// locate an indexed mesh's index data in the mapped .b72 files (nullptr + error if it can't be used):
+static char const *find_mesh_indices(Mesh const &mesh, std::unordered_map<std::string, MappedFile> const &b72_files, uint32_t *index_size, VkIndexType *index_type, std::string *error)
 {
-	for (auto &mesh : s72_scene.meshes)
+	*index_size = index_format_size(mesh.Indices.format, index_type);
+	if (*index_size == 0)
+	{
+		*error = "unsupported index format '" + mesh.Indices.format + "'";
+		return nullptr;
+	}
+	auto f = b72_files.find(mesh.Indices.src);
+	if (f == b72_files.end() || !f->second.data)
 	{
-		// Get the source file from the POSITION attribute
-		const std::string b72_file_path = "./resource/" + mesh.attributes.at("POSITION").src;
+		*error = "failed to map " + mesh.Indices.src;
+		return nullptr;
+	}
+	if (uint64_t(mesh.Indices.offset) + uint64_t(mesh.count) * *index_size > f->second.size)
+	{
+		*error = "indices run past the end of " + mesh.Indices.src;
+		return nullptr;
+	}
+	return f->second.data + mesh.Indices.offset;
+}
 
-		const uint32_t stride = mesh.attributes.at("POSITION").stride;
+uint32_t Tutorial::map_b72_files()
+{
+	// map each .b72 file once, even if many meshes (or attributes) reference it:
+	b72_files.clear();
+	auto map = [&](std::string const &src)
+	{
+		auto [f, inserted] = b72_files.emplace(src, MappedFile());
+		if (inserted && !f->second.map("./resource/" + src))
+		{
+			std::cerr << "Failed to map file: ./resource/" << src << std::endl;
+		}
+	};
+	for (auto const &mesh : s72_scene.meshes)
+	{
+		for (auto const &[name, attr] : mesh.attributes)
+		{
+			map(attr.src);
+		}
+		if (!mesh.Indices.src.empty())
+		{
+			map(mesh.Indices.src);
+		}
+	}
 
-		// Open the .b72 file
-		std::ifstream file(b72_file_path, std::ios::binary);
-		if (!file.is_open())
+	// count vertices each mesh stores; for indexed meshes, 'count' is the number of indices,
+	//  so the attribute streams hold (largest index + 1) vertices; a mesh whose vertices can't be addressed with
+	//  32-bit indices stores none, and fails to load (reported by set_mesh_vertices_map):
+	b72_vertex_counts.assign(s72_scene.meshes.size(), 0);
+	b72_vertex_errors.assign(s72_scene.meshes.size(), std::string());
+	uint64_t total = 0;
+	for (size_t m = 0; m < s72_scene.meshes.size(); ++m)
+	{
+		Mesh const &mesh = s72_scene.meshes[m];
+		uint64_t count = 0;
+		if (mesh.Indices.src.empty())
 		{
-			std::cerr << "Failed to open file: " << b72_file_path << std::endl;
+			count = mesh.count;
+		}
+		else
+		{
+			uint32_t index_size;
+			VkIndexType index_type;
+			std::string error;
+			char const *indices = find_mesh_indices(mesh, b72_files, &index_size, &index_type, &error);
+			for (uint32_t i = 0; indices && i < mesh.count; ++i)
+			{
+				uint32_t index = 0;
+				std::memcpy(&index, indices + size_t(i) * index_size, index_size); // (little-endian)
+				count = std::max(count, uint64_t(index) + 1);
+			}
+		}
+		if (count > UINT32_MAX)
+		{
+			b72_vertex_errors[m] = "index " + std::to_string(count - 1) + " is too large for 32-bit indices";
 			continue;
 		}
+		if (total + count > UINT32_MAX)
+		{
+			b72_vertex_errors[m] = "its " + std::to_string(count) + " vertices would put the scene past 32-bit indices";
+			continue;
+		}
+		b72_vertex_counts[m] = uint32_t(count);
+		total += count;
+	}
+	return uint32_t(total);
+}
 
-		bool has_color = mesh.attributes.find("COLOR") != mesh.attributes.end();
-
-		// Create ObjectVertices and bbox for this mesh
-		MsehVertices mesh_vertices;
+namespace
+{
+	// per-mesh decoding output, written by one worker and read back on the main thread:
+	struct MeshLoad
+	{
+		MsehVertices vertices;
 		BBox bbox;
+		std::vector<uint8_t> indices;	   // index data for the mesh (native format, relative to vertices.first)
+		std::vector<SceneVertex> welded; // unique vertices, if welding (copied to their final place afterward)
+		bool ok = false;
+		std::string error;
+	};
+
+	// welding compares all vertex data bit-for-bit:
+	using WeldKey = std::array<uint32_t, 13>;
+	struct WeldKeyHash
+	{
+		size_t operator()(WeldKey const &key) const
+		{
+			uint64_t h = 0xcbf29ce484222325ull;
+			for (uint32_t w : key)
+			{
+				h = (h ^ w) * 0x100000001b3ull;
+			}
+			return size_t(h ^ (h >> 32));
+		}
+	};
+	WeldKey weld_key(SceneVertex const &vertex)
+	{
+		WeldKey key;
+		std::memcpy(&key[0], &vertex.Position, sizeof(vertex.Position));
+		std::memcpy(&key[3], &vertex.Normal, sizeof(vertex.Normal));
+		std::memcpy(&key[6], &vertex.Tangent, sizeof(vertex.Tangent));
+		std::memcpy(&key[10], &vertex.TexCoord, sizeof(vertex.TexCoord));
+		key[12] = 0;
+		if (vertex.color)
+		{
+			std::memcpy(&key[12], &vertex.color.value(), sizeof(Color));
+		}
+		return key;
+	}
+
+	template <typename Index>
+	void append_indices(std::vector<uint32_t> const &from, std::vector<uint8_t> *to)
+	{
+		to->resize(from.size() * sizeof(Index));
+		for (size_t i = 0; i < from.size(); ++i)
+		{
+			Index index = Index(from[i]);
+			std::memcpy(to->data() + i * sizeof(Index), &index, sizeof(Index));
+		}
+	}
+}
 
-		mesh_vertices.first = static_cast<uint32_t>(vertices.size());
+// decode one mesh's 'vertex_count' vertices from already-mapped .b72 files into vertices [result->vertices.first, +vertex_count)
+//  of the 'streams'-layout buffer at 'out' (or into result->welded, if welding); only reads 'b72_files', so different meshes may
+//  be decoded from several threads at once:
+static bool decode_mesh_vertices(Mesh const &mesh, std::unordered_map<std::string, MappedFile> const &b72_files, uint32_t vertex_count, bool weld, SceneVertexStreams const &streams, char *out, MeshLoad *result)
+{
+	std::string *error = &result->error;
 
-		// Read each vertex by its stride
-		for (uint32_t i = 0; i < mesh.count; ++i)
+	// resolve attribute sources once per mesh, so the per-vertex loop is only pointer arithmetic:
+	struct Source
+	{
+		char const *base = nullptr;
+		uint32_t stride = 0;
+	};
+	auto get_source = [&](char const *name, size_t element_size, Source *source) -> bool
+	{
+		auto a = mesh.attributes.find(name);
+		if (a == mesh.attributes.end())
+		{
+			*error = std::string("missing attribute ") + name;
+			return false;
+		}
+		Mesh::Attribute const &attr = a->second;
+		auto f = b72_files.find(attr.src);
+		if (f == b72_files.end() || !f->second.data)
+		{
+			*error = "failed to map " + attr.src;
+			return false;
+		}
+		// last element must end inside the file:
+		if (vertex_count != 0 && uint64_t(attr.offset) + uint64_t(attr.stride) * (vertex_count - 1) + element_size > f->second.size)
 		{
-			SceneVertex vertex;
+			*error = std::string("attribute ") + name + " runs past the end of " + attr.src;
+			return false;
+		}
+		source->base = f->second.data + attr.offset;
+		source->stride = attr.stride;
+		return true;
+	};
 
-			// Read a stride worth of data into a buffer
-			std::vector<char> buffer(stride);
-			file.read(buffer.data(), stride);
+	Source position, normal, tangent, texcoord, color;
+	bool ok = get_source("POSITION", sizeof(SceneVertex::Position), &position) && get_source("NORMAL", sizeof(SceneVertex::Normal), &normal) && get_source("TANGENT", sizeof(SceneVertex::Tangent), &tangent) && get_source("TEXCOORD", sizeof(SceneVertex::TexCoord), &texcoord);
+
+	bool indexed = !mesh.Indices.src.empty();
+	char const *indices = nullptr;
+	uint32_t index_size = 0;
+	if (ok && indexed)
+	{
+		indices = find_mesh_indices(mesh, b72_files, &index_size, &result->vertices.index_type, error);
+		ok = (indices != nullptr);
+	}
 
-			// Extract Position
-			const auto &pos_attr = mesh.attributes.at("POSITION");
-			std::memcpy(&vertex.Position, buffer.data() + pos_attr.offset, sizeof(vertex.Position));
+	if (!ok)
+	{
+		if (!weld)
+		{
+			// leave a (zeroed) hole for the mesh, so every other mesh keeps its precomputed offset:
+			streams.clear(result->vertices.first, vertex_count, out);
+		}
+		return false;
+	}
+	bool has_color = mesh.attributes.count("COLOR") && get_source("COLOR", sizeof(Color), &color);
 
-			// include vertex in bbox
-			bbox.enclose(glm::vec3(vertex.Position.x, vertex.Position.y, vertex.Position.z));
+	// when welding, every mesh goes through result->welded (so it can be moved once sizes are known),
+	//  but already-indexed meshes are never re-welded:
+	bool dedupe = weld && !indexed;
 
-			// Extract Normal
-			const auto &normal_attr = mesh.attributes.at("NORMAL");
-			std::memcpy(&vertex.Normal, buffer.data() + normal_attr.offset, sizeof(vertex.Normal));
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> unique;
+	std::vector<uint32_t> weld_indices;
+	if (dedupe)
+	{
+		unique.reserve(vertex_count);
+		weld_indices.reserve(vertex_count);
+	}
 
-			// Extract Tangent
-			const auto &tangent_attr = mesh.attributes.at("TANGENT");
-			std::memcpy(&vertex.Tangent, buffer.data() + tangent_attr.offset, sizeof(vertex.Tangent));
+	// decode straight from the mapped file into the (mapped) destination:
+	for (uint32_t i = 0; i < vertex_count; ++i)
+	{
+		SceneVertex vertex;
+		std::memcpy(&vertex.Position, position.base + size_t(i) * position.stride, sizeof(vertex.Position));
+		std::memcpy(&vertex.Normal, normal.base + size_t(i) * normal.stride, sizeof(vertex.Normal));
+		std::memcpy(&vertex.Tangent, tangent.base + size_t(i) * tangent.stride, sizeof(vertex.Tangent));
+		std::memcpy(&vertex.TexCoord, texcoord.base + size_t(i) * texcoord.stride, sizeof(vertex.TexCoord));
+		if (has_color)
+		{
+			Color c;
+			std::memcpy(&c, color.base + size_t(i) * color.stride, sizeof(c));
+			vertex.color = c;
+		}
 
-			// Extract TexCoord
-			const auto &texcoord_attr = mesh.attributes.at("TEXCOORD");
-			std::memcpy(&vertex.TexCoord, buffer.data() + texcoord_attr.offset, sizeof(vertex.TexCoord));
+		// include vertex in bbox
+		result->bbox.enclose(glm::vec3(vertex.Position.x, vertex.Position.y, vertex.Position.z));
 
-			// Extract Color if present
-			if (has_color)
+		if (dedupe)
+		{
+			auto [u, inserted] = unique.emplace(weld_key(vertex), uint32_t(result->welded.size()));
+			if (inserted)
 			{
-				glm::u8vec4 color;
-				const auto &color_attr = mesh.attributes.at("COLOR");
-				std::memcpy(&color, buffer.data() + color_attr.offset, sizeof(color));
-				vertex.color = std::optional<Color>{{color.r, color.g, color.b, color.a}};
+				result->welded.emplace_back(vertex);
 			}
+			weld_indices.emplace_back(u->second);
+		}
+		else if (weld)
+		{
+			result->welded.emplace_back(vertex);
+		}
+		else
+		{
+			streams.store(result->vertices.first + i, vertex, out);
+		}
+	}
 
-			// Push the vertex into the vertices vector
-			vertices.push_back(vertex);
+	if (indexed)
+	{
+		result->vertices.count = vertex_count;
+		result->vertices.index_count = mesh.count;
+		result->indices.assign(indices, indices + size_t(mesh.count) * index_size);
+	}
+	else if (dedupe)
+	{
+		result->vertices.count = uint32_t(result->welded.size());
+		result->vertices.index_count = mesh.count;
+		// 16-bit indices whenever they can address every unique vertex:
+		if (result->welded.size() <= 0x10000)
+		{
+			result->vertices.index_type = VK_INDEX_TYPE_UINT16;
+			append_indices<uint16_t>(weld_indices, &result->indices);
+		}
+		else
+		{
+			result->vertices.index_type = VK_INDEX_TYPE_UINT32;
+			append_indices<uint32_t>(weld_indices, &result->indices);
 		}
-		// save in global
-		s72_scene.mesh_bbox_map[&mesh] = bbox;
+	}
+	else
+	{
+		result->vertices.count = vertex_count;
+	}
+	return true;
+}
 
-		// Set vertex count in object_vertices
-		mesh_vertices.count = mesh.count;
+uint32_t Tutorial::set_mesh_vertices_map(char *vertices, std::vector<uint8_t> *indices)
+{
+	bool weld = rtg.configuration.weld_vertices;
 
-		s72_scene.mesh_vertices_map[&mesh] = mesh_vertices;
+	s72_scene.mesh_vertices.assign(s72_scene.meshes.size(), MsehVertices{});
+	s72_scene.mesh_bboxes.assign(s72_scene.meshes.size(), BBox{});
 
-		// std::cout << "Last vertex coordinates: " << vertices.back().Position.x << ", "
-		//		  << vertices.back().Position.y << ", " << vertices.back().Position.z << "\n";
+	// (serial) assign every mesh its range in scene order, so offsets don't depend on thread timing:
+	std::vector<MeshLoad> results(s72_scene.meshes.size());
+	uint32_t first = 0;
+	for (size_t m = 0; m < s72_scene.meshes.size(); ++m)
+	{
+		results[m].vertices.first = first;
+		first += b72_vertex_counts[m];
+	}
+	SceneVertexStreams streams{.count = first, .packed = rtg.configuration.packed_vertices};
+
+	// (parallel) decode meshes into their ranges:
+	rtg.jobs.parallel_for(s72_scene.meshes.size(), 1, [&](size_t begin, size_t end)
+						  {
+							  for (size_t m = begin; m < end; ++m)
+							  {
+								  MeshLoad &result = results[m];
+								  if (!b72_vertex_errors[m].empty())
+								  {
+									  result.error = b72_vertex_errors[m];
+									  continue;
+								  }
+								  result.ok = decode_mesh_vertices(s72_scene.meshes[m], b72_files, b72_vertex_counts[m], weld, streams, vertices, &result);
+							  } });
+
+	if (weld)
+	{
+		// (serial) welded meshes shrank, so pack them tightly, still in scene order:
+		first = 0;
+		for (auto &result : results)
+		{
+			result.vertices.first = first;
+			first += result.vertices.count;
+		}
+		streams.count = first; // (the attribute stream now starts right after the fewer positions)
+		// (parallel) ...and copy them to their final places:
+		rtg.jobs.parallel_for(results.size(), 1, [&](size_t begin, size_t end)
+							  {
+								  for (size_t m = begin; m < end; ++m)
+								  {
+									  MeshLoad &result = results[m];
+									  for (uint32_t i = 0; i < uint32_t(result.welded.size()); ++i)
+									  {
+										  streams.store(result.vertices.first + i, result.welded[i], vertices);
+									  }
+									  result.welded = std::vector<SceneVertex>();
+								  } });
+	}
 
-		file.close();
+	// (serial) gather index data (4-byte aligned per mesh, so any index type can start there) and save in global:
+	indices->clear();
+	uint32_t welded_vertices = 0;
+	for (size_t m = 0; m < s72_scene.meshes.size(); ++m)
+	{
+		Mesh &mesh = s72_scene.meshes[m];
+		MeshLoad &result = results[m];
+		if (!result.ok)
+		{
+			std::cerr << "Failed to load vertices for mesh '" << mesh.name << "' (" << result.error << "); it will not be drawn." << std::endl;
+			result.vertices.count = 0;
+			result.vertices.index_count = 0;
+		}
+		if (result.vertices.index_count != 0)
+		{
+			indices->resize((indices->size() + 3) & ~size_t(3));
+			result.vertices.index_offset = indices->size();
+			indices->insert(indices->end(), result.indices.begin(), result.indices.end());
+		}
+		if (weld && mesh.Indices.src.empty())
+		{
+			welded_vertices += mesh.count - result.vertices.count;
+		}
+		s72_scene.mesh_bboxes[m] = result.bbox;
+		s72_scene.mesh_vertices[m] = result.vertices;
+	}
+	if (weld)
+	{
+		std::cout << "Welding removed " << welded_vertices << " duplicate vertices.\n";
 	}
+
+	return first;
 }
 
 // dfs order
-void Tutorial::process_node(std::vector<SceneVertex> &vertices, Node *node)
+void Tutorial::process_node(Node *node)
 {
-	if (!node || !node->mesh_)
+	if (!node || !node->mesh_ || node->index_ < 0)
 		return;
 
 	Mesh *mesh_ = node->mesh_;
 
 	// Create ObjectVertices for this mesh
-	auto obj_vertices = s72_scene.mesh_vertices_map[mesh_];
+	auto obj_vertices = s72_scene.mesh_vertices[mesh_->index_];
 
 	SceneObject scene_object;
-	std::memcpy(&(scene_object.scene_object_vertices), &obj_vertices, sizeof(obj_vertices));
-
-	// scene_object.scene_object_vertices = obj_vertices;
+	scene_object.scene_object_vertices = obj_vertices;
 
 	// Push the ObjectVertices to the scene_object_vertices vector
 	// scene_object_vertices.push_back(obj_vertices);
 
-	// Push the transform matrix to scene_transform
-	glm::vec4 extra_column = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	glm::mat4 combined_matrix = glm::mat4(
-		glm::vec4(node->make_local_to_world()[0], extra_column[0]),
-		glm::vec4(node->make_local_to_world()[1], extra_column[1]),
-		glm::vec4(node->make_local_to_world()[2], extra_column[2]),
-		glm::vec4(node->make_local_to_world()[3], extra_column[3]));
-	// scene_transform.push_back(combined_matrix);
-
-	scene_object.scene_transform = combined_matrix;
+	// initial transform (build_node_hierarchy has already computed it):
+	scene_object.scene_transform = s72_scene.hierarchy.world[node->index_];
 	scene_object.object_node_ = node;
+	scene_object.node_index = node->index_;
+	scene_object.mesh_index = mesh_->index_;
 	scene_objects.push_back(scene_object);
-
-	// save in global
-	s72_scene.transforms[node] = combined_matrix;
 }
 
-void Tutorial::load_vertex_from_b72(std::vector<SceneVertex> &vertices)
+uint32_t Tutorial::load_vertex_from_b72(char *vertices, std::vector<uint8_t> *indices)
 {
 	// std::cout << "load_vertex_from_b72\n";
-	set_mesh_vertices_map(vertices);
-
-	// DFS function to traverse and process vertices for each node
-	std::function<void(Node *)> dfs_process_node = [&](Node *node)
-	{
-		if (!node)
-			return;
-
-		// Process node if it has a mesh
-		process_node(vertices, node);
-
-		// Traverse the children nodes
-		for (const auto &child_variant : node->children)
-		{
-			Node *child_node = find_node_by_name_or_index(child_variant);
-			if (child_node)
-			{
-				dfs_process_node(child_node);
-			}
-		}
-	};
+	uint32_t used = set_mesh_vertices_map(vertices, indices);
+	build_scene_objects();
+	return used;
+}
 
-	// Start DFS from each root node in the scene
-	for (const auto &[key, root_node] : s72_scene.nodes_map)
+void Tutorial::build_scene_objects()
+{
+	// every node reachable from the scene roots, once each, parents before children:
+	//  (walking the trees from every entry of nodes_map re-visited each node once per ancestor)
+	for (Node *node : s72_scene.hierarchy.nodes)
 	{
-		dfs_process_node(root_node);
+		process_node(node);
 	}
-	// std::cout << "load_vertex_from_b72 done\n";
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 #include "lib/PosColVertex.hpp"
 #include "lib/PosNorTexVertex.hpp"
 #include "lib/SceneVertex.hpp"
+#include "lib/MappedFile.hpp"
 #include "lib/mat4.hpp"
 #include "RTG.hpp"
 #include "Scene.hpp"
+#include "SceneCache.hpp"
+#include "DriverBatch.hpp"
+#include "AnimationBake.hpp"
+#include "SceneBVH.hpp"
+#include "OcclusionBuffer.hpp"
 
 // Forward declarations of the structs
 struct Node;
@@ -180,10 +186,144 @@ struct Tutorial : RTG::Application
 
 		VkPipeline handle = VK_NULL_HANDLE;
 
+		// position-only variant (binds only vertex stream 0, writes only depth) for depth prepasses:
+		VkPipeline depth_only = VK_NULL_HANDLE;
+
 		void create(RTG &, VkRenderPass render_pass, uint32_t subpass);
 		void destroy(RTG &);
 	} scenes_pipeline;
 
+	// compute pipelines that fill ScenesPipeline's Transforms on the GPU (`--gpu-transforms`):
+	//  'handle' computes world transforms one level of s72_scene.hierarchy at a time (every parent is done by
+	//  the previous dispatch), then 'instances' writes each visible instance's Transform from its node's world.
+	struct TransformsPipeline
+	{
+		// descriptor set layouts:
+		VkDescriptorSetLayout set0_Nodes = VK_NULL_HANDLE;
+
+		// types for descriptors:
+		struct Local // one NodeTRS (binding 0)
+		{
+			float position[4]; // xyz_
+			float rotation[4]; // xyzw
+			float scale[4];	   // xyz_
+		};
+		static_assert(sizeof(Local) == 4 * 4 + 4 * 4 + 4 * 4, "Local is the expected size.");
+
+		struct Level // one node, in level order (binding 1)
+		{
+			uint32_t node;	// index into s72_scene.hierarchy
+			int32_t parent; // -1 for roots
+		};
+		static_assert(sizeof(Level) == 4 + 4, "Level is packed.");
+
+		// (binding 2: world transform of each node, as mat4; binding 3: node index of each instance;
+		//  binding 4: ScenesPipeline::Transform of each instance)
+
+		// push constants
+		struct Push
+		{
+			mat4 CLIP_FROM_WORLD; // (instances)
+			uint32_t first;		  // first Level of this dispatch (handle)
+			uint32_t count;		  // Levels (handle) or instances (instances) to process
+		};
+
+		static constexpr uint32_t GroupSize = 64; // local_size_x of transforms.comp
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkPipeline handle = VK_NULL_HANDLE;	   // one level of world transforms
+		VkPipeline instances = VK_NULL_HANDLE; // instance Transforms
+
+		void create(RTG &);
+		void destroy(RTG &);
+	} transforms_pipeline;
+
+	// compute pipeline that frustum-culls scene objects on the GPU and writes their draws (`--culling gpu`):
+	//  after transforms_pipeline has computed world transforms, each invocation tests one object's bounds,
+	//  writes the Transform of a visible object, and appends its indirect draw command to its draw kind's list.
+	//  With `--culling hiz` it also occlusion-culls, in two phases: phase 0 draws the objects visible last
+	//  frame, whose depth depth_pyramid_pipeline reduces; phase 1 tests every object against that pyramid.
+	struct CullPipeline
+	{
+		// descriptor set layouts:
+		VkDescriptorSetLayout set0_Objects = VK_NULL_HANDLE;
+
+		// types for descriptors:
+		struct Object // one scene object (binding 0; static)
+		{
+			float bbox_min[4];	  // xyz_, in the object's own space
+			float bbox_max[4];	  // xyz_
+			uint32_t node;		  // index into Scene_worlds
+			uint32_t kind;		  // DrawKind
+			uint32_t base;		  // first command of this kind in Scene_draw_commands
+			uint32_t slot;		  // this object's own command (used when not compacting)
+			uint32_t count;		  // vertices, or indices if indexed
+			uint32_t first;		  // first vertex (vertexOffset, if indexed)
+			uint32_t first_index; // first index, if indexed
+			uint32_t padding_;
+		};
+		static_assert(sizeof(Object) == 4 * 4 + 4 * 4 + 8 * 4, "Object is packed.");
+
+		// scene objects are drawn with one indirect call per kind, since each needs its own index type:
+		enum DrawKind : uint32_t
+		{
+			Unindexed = 0,
+			Indexed16 = 1,
+			Indexed32 = 2,
+			DrawKinds = 3,
+		};
+
+		// (binding 1: world transform of each node, as mat4; binding 2: ScenesPipeline::Transform of each object;
+		//  binding 3: VkDrawIndexedIndirectCommand (or VkDrawIndirectCommand, in the same 20 bytes) per object;
+		//  binding 4: count of visible draws of each kind;
+		//  with occlusion, binding 5: uint32_t per object, nonzero if drawn last frame; binding 6: the depth pyramid)
+		static constexpr uint32_t CommandStride = uint32_t(sizeof(VkDrawIndexedIndirectCommand));
+		static_assert(sizeof(VkDrawIndirectCommand) <= CommandStride, "Unindexed commands fit the indexed stride.");
+
+		// push constants
+		struct Push
+		{
+			mat4 CLIP_FROM_WORLD;
+			uint32_t count;			// objects to process
+			uint32_t phase;			// (occlusion) 0: objects drawn last frame; 1: every object, against the depth pyramid
+			uint32_t first_command; // where this dispatch's commands start in Scene_draw_commands (in commands)
+			uint32_t first_count;	// where its counts start in Scene_draw_counts (in uint32_ts)
+			uint32_t width, height; // (occlusion) size of the depth image the pyramid was built from
+		};
+
+		static constexpr uint32_t GroupSize = 64; // local_size_x of cull.comp
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkPipeline handle = VK_NULL_HANDLE;
+
+		// 'compact' packs visible draws at the front of each kind's list (drawn with vkCmdDraw*IndirectCount);
+		//  otherwise every object keeps its slot and hidden ones get instanceCount 0 (drawn with vkCmdDraw*Indirect):
+		void create(RTG &, bool compact, bool occlusion);
+		void destroy(RTG &);
+	} cull_pipeline;
+
+	// compute pipeline that builds the depth pyramid for cull_pipeline's occlusion test (`--culling hiz`):
+	//  one dispatch per level, each reducing the depth image (or the level before) to the farthest depth of 2x2 texels
+	//  (so a depth pixel p lands in texel min(p >> (level + 1), last) of each level).
+	struct DepthPyramidPipeline
+	{
+		// descriptor set layouts:
+		VkDescriptorSetLayout set0_Level = VK_NULL_HANDLE; // binding 0: source (sampled); binding 1: level (storage image)
+
+		// no push constants
+
+		static constexpr uint32_t GroupSize = 8; // local_size_x and local_size_y of depth_pyramid.comp
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkPipeline handle = VK_NULL_HANDLE;
+
+		void create(RTG &);
+		void destroy(RTG &);
+	} depth_pyramid_pipeline;
+
 	struct HeadlessPipeline
 	{
 		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
@@ -209,39 +349,54 @@ struct Tutorial : RTG::Application
 	{
 		VkCommandBuffer command_buffer = VK_NULL_HANDLE; // from the command pool above; reset at the start of every render.
 
+		// all per-frame streamed data lives in one device-local buffer, filled each frame from rtg.helpers'
+		//  staging ring with a single vkCmdCopyBuffer (see update_frame_data / render):
+		Helpers::AllocatedBuffer frame_data; // device-local; holds the ranges below
+
+		struct Range
+		{
+			VkDeviceSize offset = 0; // byte offset of the range inside frame_data
+			VkDeviceSize size = 0;	 // capacity of the range in bytes (0 => not allocated yet)
+		};
+
 		// location for lines data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer lines_vertices_src; // host coherent; mapped
-		Helpers::AllocatedBuffer lines_vertices;	 // device-local
+		Range lines_vertices;
 
 		// location for LinesPipeline::Camera data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer Camera_src; // host coherent; mapped
-		Helpers::AllocatedBuffer Camera;	 // device-local
-		VkDescriptorSet Camera_descriptors;	 // references Camera
+		Range Camera;
+		VkDescriptorSet Camera_descriptors; // references Camera
 
 		// location for ObjectsPipeline::World data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer World_src; // host coherent; mapped
-		Helpers::AllocatedBuffer World;		// device-local
-		VkDescriptorSet World_descriptors;	// references World
+		Range World;
+		VkDescriptorSet World_descriptors; // references World
 
 		// location for ObjectsPipeline::Transforms data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer Transforms_src; // host coherent; mapped
-		Helpers::AllocatedBuffer Transforms;	 // device-local
-		VkDescriptorSet Transforms_descriptors;	 // references Transforms
+		Range Transforms;
+		VkDescriptorSet Transforms_descriptors; // references Transforms
 
 		// // location for ScenesPipeline::Camera data: (streamed to GPU per-frame)
 		// Helpers::AllocatedBuffer Scene_camera_src; // host coherent; mapped
 		// Helpers::AllocatedBuffer Scene_camera;	   // device-local
 		// VkDescriptorSet Scene_camera_descriptors;  // references Camera
 
-		// location for ObjectsPipeline::World data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer Scene_world_src; // host coherent; mapped
-		Helpers::AllocatedBuffer Scene_world;	  // device-local
-		VkDescriptorSet Scene_world_descriptors;  // references World
+		// location for ScenesPipeline::World data: (streamed to GPU per-frame)
+		Range Scene_world;
+		VkDescriptorSet Scene_world_descriptors; // references Scene_world
 
-		// location for ScenesPipeline::Transforms data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer Scene_transforms_src; // host coherent; mapped
-		Helpers::AllocatedBuffer Scene_transforms;	   // device-local
-		VkDescriptorSet Scene_transforms_descriptors;  // references Transforms
+		// location for ScenesPipeline::Transforms data: (streamed to GPU per-frame, or written by transforms_pipeline)
+		Range Scene_transforms;
+		VkDescriptorSet Scene_transforms_descriptors; // references Scene_transforms
+
+		// locations for TransformsPipeline data: (with `--gpu-transforms`)
+		Range Scene_locals;			// TransformsPipeline::Local per node (streamed to GPU per-frame)
+		Range Scene_worlds;			// mat4 per node (written and read by transforms_pipeline)
+		Range Scene_instance_nodes; // uint32_t per instance (streamed to GPU per-frame)
+		VkDescriptorSet Scene_nodes_descriptors = VK_NULL_HANDLE; // references the three ranges above, scene_transform_levels, and Scene_transforms
+
+		// locations for CullPipeline data: (with `--culling gpu`; written by cull_pipeline, read by the indirect draws)
+		Range Scene_draw_commands;								  // CullPipeline::CommandStride bytes per scene object (per phase, with `--culling hiz`)
+		Range Scene_draw_counts;								  // uint32_t per CullPipeline::DrawKind (per phase; zeroed per-frame)
+		VkDescriptorSet Scene_cull_descriptors = VK_NULL_HANDLE; // references scene_cull_objects, Scene_worlds, Scene_transforms, the two ranges above, and (with `--culling hiz`) scene_cull_visibility and depth_pyramid
 
 		// location for ScenesPipeline::Transforms data: (streamed to GPU per-frame)
 		Helpers::AllocatedBuffer Headless_src; // host coherent; mapped
@@ -250,11 +405,19 @@ struct Tutorial : RTG::Application
 	};
 	std::vector<Workspace> workspaces;
 
+	// alignment of ranges inside Workspace::frame_data (satisfies uniform and storage buffer offset limits):
+	VkDeviceSize frame_data_alignment = 16;
+
+	// make sure workspace.frame_data can hold the given (variable-sized) ranges; [re-]allocates the buffer
+	//  and rewrites the workspace's descriptor sets if it had to grow:
+	void update_frame_data(Workspace &workspace, VkDeviceSize lines_bytes, VkDeviceSize transforms_bytes, VkDeviceSize scene_transforms_bytes, VkDeviceSize scene_instance_nodes_bytes = 0);
+
 	//-------------------------------------------------------------------
 	// static scene resources:
 	Helpers::AllocatedBuffer object_vertices;
 
 	Helpers::AllocatedBuffer scene_vertices;
+	SceneVertexStreams scene_streams; // layout of scene_vertices: positions (binding 0), then other attributes (binding 1)
 
 	Helpers::AllocatedBuffer headless_resource;
 
@@ -267,14 +430,32 @@ struct Tutorial : RTG::Application
 	ObjectVertices plane_vertices;
 	ObjectVertices torus_vertices;
 
+	// scene geometry indices, for indexed meshes (see MsehVertices):
+	Helpers::AllocatedBuffer scene_indices;
+
+	// s72_scene.hierarchy in level order (roots, then their children, ...) for transforms_pipeline:
+	Helpers::AllocatedBuffer scene_transform_levels; // TransformsPipeline::Level per node
+	std::vector<uint32_t> transform_level_starts;	 // first Level of each level, then the node count
+
+	// scene_objects as cull_pipeline sees them:
+	Helpers::AllocatedBuffer scene_cull_objects;						// CullPipeline::Object per scene object
+	std::array<uint32_t, CullPipeline::DrawKinds> scene_draw_firsts{}; // first command of each draw kind
+	std::array<uint32_t, CullPipeline::DrawKinds> scene_draw_counts{}; // scene objects of each draw kind
+	Helpers::AllocatedBuffer scene_cull_visibility;					// uint32_t per scene object (`--culling hiz`; read and written by cull_pipeline)
+	uint32_t cull_phases() const { return rtg.configuration.cull_mode == HIZ ? 2 : 1; } // cull_pipeline dispatches (and draw lists) per frame
+
 	struct SceneObject
 	{
-		ObjectVertices scene_object_vertices;
+		MsehVertices scene_object_vertices;
 		glm::mat4 scene_transform;
 		Node *object_node_;
+		int32_t node_index; // into s72_scene.hierarchy
+		uint32_t mesh_index; // into s72_scene.mesh_vertices / mesh_bboxes
 	};
 
-	std::vector<SceneObject> scene_objects;
+	std::vector<SceneObject> scene_objects; // (in s72_scene.hierarchy order, so node_index ascends)
+	SceneBVH scene_bvh;						// over scene_objects' world bounds (scene_bvh object i is scene_objects[i])
+	OcclusionBuffer occlusion_buffer;		// (`--culling occlusion`) occluders picked from scene_objects at load time
 
 	std::vector<Helpers::AllocatedImage> textures;
 	std::vector<VkImageView> texture_views;
@@ -282,10 +463,26 @@ struct Tutorial : RTG::Application
 	VkDescriptorPool texture_descriptor_pool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> texture_descriptors; // allocated from texture_descriptor_pool
 
+	std::string s72_path;
+	SceneCache scene_cache; // holds the cached vertex data until it is uploaded
+	bool scene_from_cache = false;
+	uint32_t scene_cache_options() const; // SceneCache::Options matching the configuration
+
 	void load_s72();
-	void set_mesh_vertices_map(std::vector<SceneVertex> &vertices);
-	void process_node(std::vector<SceneVertex> &vertices, Node *node);
-	void load_vertex_from_b72(std::vector<SceneVertex> &vertices);
+	DriverBatch driver_batch; // evaluates s72_scene.drivers each frame (built by load_s72)
+	AnimationBake animation_bake; // played back instead of driver_batch when non-empty (`--bake-animation`)
+	// .b72 data, mapped while the scene is being loaded:
+	std::unordered_map<std::string, MappedFile> b72_files;
+	std::vector<uint32_t> b72_vertex_counts; // vertices stored for each mesh (s72_scene.meshes order)
+	std::vector<std::string> b72_vertex_errors; // why a mesh stores no vertices, if it can't be addressed with 32-bit indices (else empty)
+
+	uint32_t map_b72_files(); // maps every referenced .b72; returns the number of vertices set_mesh_vertices_map will decode
+	// decodes mapped .b72 data into split vertex streams (laid out as SceneVertexStreams for the returned count) and index data into *indices;
+	//  returns the number of vertices actually used (fewer than decoded, if welding):
+	uint32_t set_mesh_vertices_map(char *vertices, std::vector<uint8_t> *indices);
+	void process_node(Node *node);
+	void build_scene_objects();												// fills scene_objects from s72_scene.hierarchy
+	uint32_t load_vertex_from_b72(char *vertices, std::vector<uint8_t> *indices); // set_mesh_vertices_map + build_scene_objects
 	//--------------------------------------------------------------------
 	//  Resources that change when the swapchain is resized:
 
@@ -293,6 +490,15 @@ struct Tutorial : RTG::Application
 
 	Helpers::AllocatedImage swapchain_depth_image;
 	VkImageView swapchain_depth_image_view = VK_NULL_HANDLE;
+
+	// with `--culling hiz`, the depth pyramid built from swapchain_depth_image each frame (see DepthPyramidPipeline):
+	VkRenderPass occluder_render_pass = VK_NULL_HANDLE;	   // depth-only pass over the framebuffers; leaves depth readable
+	Helpers::AllocatedImage depth_pyramid;				   // VK_FORMAT_R32_SFLOAT; mip 0 is half the depth image (rounded up)
+	VkImageView depth_pyramid_view = VK_NULL_HANDLE;	   // every level (sampled by cull_pipeline)
+	std::vector<VkImageView> depth_pyramid_level_views;	   // one level each (written by depth_pyramid_pipeline, then sampled for the next)
+	VkSampler depth_pyramid_sampler = VK_NULL_HANDLE;	   // nearest, clamped (the shaders only texelFetch)
+	VkDescriptorPool depth_pyramid_descriptor_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> depth_pyramid_descriptors; // one per level, from depth_pyramid_descriptor_pool
 	std::vector<VkFramebuffer> swapchain_framebuffers;
 	// used from on_swapchain and the destructor: (framebuffers are created in on_swapchain)
 	void destroy_framebuffers();
@@ -321,11 +527,18 @@ struct Tutorial : RTG::Application
 
 	struct ScenesObjectInstance
 	{
-		ObjectVertices vertices;
-		ScenesPipeline::Transform transform;
+		MsehVertices vertices;
+		ScenesPipeline::Transform transform; // (not written with `--gpu-transforms`)
+		uint32_t node_index = 0;			 // into s72_scene.hierarchy
 		uint32_t texture = 0;
 	};
 	std::vector<ScenesObjectInstance> scene_instances;
+	glm::mat4 scene_clip_from_world = glm::mat4(1.0f); // CLIP_FROM_WORLD of the scene camera, as of the last update()
+	static constexpr size_t InstanceChunk = 256;	 // scene objects refit / written per job in update()
+	std::vector<std::pair<uint32_t, uint32_t>> moved_node_ranges; // nodes that moved this frame (scratch for update())
+	std::vector<uint32_t> moved_objects;						  // scene objects on them (scratch for update())
+	std::vector<uint32_t> visible_objects;						  // scene objects that survived culling (scratch for update())
+	std::vector<uint8_t> occluded_objects;						  // [visible object] hidden by occlusion_buffer (scratch for update())
 
 	//--------------------------------------------------------------------
 	// Rendering function, uses all the resources above to queue work to draw a frame:
@@ -5,6 +5,9 @@
 
 #include <vulkan/utility/vk_format_utils.h> //useful for byte counting
 
+#include <algorithm>
+#include <string>
+#include <iterator>
 #include <utility>
 #include <cassert>
 #include <cstring>
@@ -59,25 +62,150 @@ Helpers::Allocation::~Allocation()
 
 //----------------------------
 
+VkDeviceSize Helpers::block_size_for(uint32_t memory_type_index) const
+{
+	// don't let one block take a big bite out of a small heap (e.g., 256MB device-local host-visible "BAR" memory):
+	VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type_index].heapIndex].size;
+	return std::min(DefaultBlockSize, std::max<VkDeviceSize>(heap_size / 8, 1024 * 1024));
+}
+
 Helpers::Allocation Helpers::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, MapFlag map)
 {
+	assert(size > 0);
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0); // Vulkan alignments are powers of two
+
+	VkDeviceSize block_size = block_size_for(memory_type_index);
+	if (size > block_size / 2)
+	{
+		// big requests would mostly waste a shared block, so they get memory of their own:
+		return allocate_dedicated(size, memory_type_index, map);
+	}
+
+	// find a block of the right type with a free range that fits (first fit), or make a new block:
+	MemoryBlock *block = nullptr;
+	VkDeviceSize offset = 0;
+	for (MemoryBlock &candidate : memory_blocks)
+	{
+		if (candidate.dedicated || candidate.memory_type_index != memory_type_index)
+			continue;
+		for (MemoryBlock::Range const &range : candidate.free_ranges)
+		{
+			VkDeviceSize aligned = (range.offset + alignment - 1) & ~(alignment - 1);
+			if (aligned + size <= range.offset + range.size)
+			{
+				block = &candidate;
+				offset = aligned;
+				break;
+			}
+		}
+		if (block)
+			break;
+	}
+
+	if (block == nullptr)
+	{
+		MemoryBlock new_block;
+		new_block.size = block_size;
+		new_block.memory_type_index = memory_type_index;
+
+		VkMemoryAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = new_block.size,
+			.memoryTypeIndex = memory_type_index};
+
+		VK(vkAllocateMemory(rtg.device, &alloc_info, nullptr, &new_block.handle));
+
+		new_block.free_ranges.emplace_back(MemoryBlock::Range{.offset = 0, .size = new_block.size});
+
+		allocation_stats.device_allocations += 1;
+		allocation_stats.reserved += new_block.size;
+
+		memory_blocks.emplace_back(std::move(new_block));
+		block = &memory_blocks.back();
+		offset = 0;
+	}
+
+	{ // carve [offset, offset + size) out of the free range that contains it:
+		auto range = std::find_if(block->free_ranges.begin(), block->free_ranges.end(), [&](MemoryBlock::Range const &r)
+								  { return r.offset <= offset && offset + size <= r.offset + r.size; });
+		assert(range != block->free_ranges.end());
+
+		MemoryBlock::Range before{.offset = range->offset, .size = offset - range->offset};
+		MemoryBlock::Range after{.offset = offset + size, .size = (range->offset + range->size) - (offset + size)};
+
+		range = block->free_ranges.erase(range);
+		if (after.size != 0)
+			range = block->free_ranges.insert(range, after);
+		if (before.size != 0)
+			block->free_ranges.insert(range, before);
+	}
+
+	if (map == Mapped && block->mapped == nullptr)
+	{
+		// (memory can only be mapped once, so map the whole block and leave it mapped)
+		VK(vkMapMemory(rtg.device, block->handle, 0, VK_WHOLE_SIZE, 0, &block->mapped));
+	}
+
+	block->allocations += 1;
+	block->used += size;
+
+	allocation_stats.sub_allocations += 1;
+	allocation_stats.used += size;
+	allocation_stats.peak_used = std::max(allocation_stats.peak_used, allocation_stats.used);
+	allocation_stats.peak_reserved = std::max(allocation_stats.peak_reserved, allocation_stats.reserved);
+	allocation_stats.peak_blocks = std::max(allocation_stats.peak_blocks, uint32_t(memory_blocks.size()));
+
 	Helpers::Allocation allocation;
+	allocation.handle = block->handle;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.mapped = (map == Mapped ? block->mapped : nullptr);
+	return allocation;
+}
 
+Helpers::Allocation Helpers::allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index, MapFlag map, VkImage image)
+{
+	MemoryBlock block;
+	block.size = size;
+	block.memory_type_index = memory_type_index;
+	block.dedicated = true;
+
+	VkMemoryDedicatedAllocateInfo dedicated_info{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+		.image = image,
+	};
 	VkMemoryAllocateInfo alloc_info{
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = (image != VK_NULL_HANDLE ? &dedicated_info : nullptr),
 		.allocationSize = size,
 		.memoryTypeIndex = memory_type_index};
 
-	VK(vkAllocateMemory(rtg.device, &alloc_info, nullptr, &allocation.handle));
-
-	allocation.size = size;
-	allocation.offset = 0;
+	VK(vkAllocateMemory(rtg.device, &alloc_info, nullptr, &block.handle));
 
 	if (map == Mapped)
 	{
-		VK(vkMapMemory(rtg.device, allocation.handle, 0, allocation.size, 0, &allocation.mapped));
+		VK(vkMapMemory(rtg.device, block.handle, 0, VK_WHOLE_SIZE, 0, &block.mapped));
 	}
 
+	block.allocations = 1;
+	block.used = size;
+
+	allocation_stats.device_allocations += 1;
+	allocation_stats.dedicated_allocations += 1;
+	allocation_stats.reserved += size;
+	allocation_stats.used += size;
+	allocation_stats.peak_used = std::max(allocation_stats.peak_used, allocation_stats.used);
+	allocation_stats.peak_reserved = std::max(allocation_stats.peak_reserved, allocation_stats.reserved);
+	allocation_stats.peak_blocks = std::max(allocation_stats.peak_blocks, uint32_t(memory_blocks.size() + 1));
+
+	Helpers::Allocation allocation;
+	allocation.handle = block.handle;
+	allocation.offset = 0;
+	allocation.size = size;
+	allocation.mapped = block.mapped;
+
+	memory_blocks.emplace_back(std::move(block));
+
 	return allocation;
 }
 
@@ -88,17 +216,84 @@ Helpers::Allocation Helpers::allocate(VkMemoryRequirements const &req, VkMemoryP
 
 void Helpers::free(Helpers::Allocation &&allocation)
 {
-	if (allocation.mapped != nullptr)
+	if (allocation.handle == VK_NULL_HANDLE)
+		return;
+
+	auto block = std::find_if(memory_blocks.begin(), memory_blocks.end(), [&](MemoryBlock const &b)
+							  { return b.handle == allocation.handle; });
+	if (block == memory_blocks.end())
 	{
-		vkUnmapMemory(rtg.device, allocation.handle);
-		allocation.mapped = nullptr;
+		throw std::runtime_error("Freeing an allocation that doesn't belong to any memory block.");
 	}
 
-	vkFreeMemory(rtg.device, allocation.handle, nullptr);
+	assert(block->allocations > 0 && block->used >= allocation.size);
+	block->allocations -= 1;
+	block->used -= allocation.size;
+	allocation_stats.used -= allocation.size;
+
+	if (!block->dedicated)
+	{
+		// return [offset, offset + size) to the free list, merging with its neighbors:
+		MemoryBlock::Range freed{.offset = allocation.offset, .size = allocation.size};
+		auto next = std::lower_bound(block->free_ranges.begin(), block->free_ranges.end(), freed.offset, [](MemoryBlock::Range const &r, VkDeviceSize offset)
+									 { return r.offset < offset; });
+		if (next != block->free_ranges.end() && freed.offset + freed.size == next->offset)
+		{
+			freed.size += next->size;
+			next = block->free_ranges.erase(next);
+		}
+		if (next != block->free_ranges.begin() && std::prev(next)->offset + std::prev(next)->size == freed.offset)
+		{
+			std::prev(next)->size += freed.size;
+		}
+		else
+		{
+			block->free_ranges.insert(next, freed);
+		}
+	}
+
+	if (block->allocations == 0)
+	{
+		// keep one empty shared block per memory type around so alloc/free patterns don't thrash vkAllocateMemory:
+		bool keep = !block->dedicated && std::none_of(memory_blocks.begin(), memory_blocks.end(), [&](MemoryBlock const &b)
+													  { return &b != &*block && !b.dedicated && b.allocations == 0 && b.memory_type_index == block->memory_type_index; });
+		if (!keep)
+		{
+			if (block->mapped != nullptr)
+			{
+				vkUnmapMemory(rtg.device, block->handle);
+			}
+			vkFreeMemory(rtg.device, block->handle, nullptr);
+			allocation_stats.reserved -= block->size;
+			memory_blocks.erase(block);
+		}
+	}
 
 	allocation.handle = VK_NULL_HANDLE;
 	allocation.offset = 0;
 	allocation.size = 0;
+	allocation.mapped = nullptr;
+}
+
+void Helpers::report_allocation_stats() const
+{
+	auto MB = [](VkDeviceSize bytes)
+	{
+		return std::to_string((bytes + 1024 * 1024 - 1) / (1024 * 1024)) + "MB";
+	};
+
+	std::cout << "Device memory: " << allocation_stats.device_allocations << " vkAllocateMemory calls ("
+			  << allocation_stats.dedicated_allocations << " dedicated) for " << allocation_stats.sub_allocations << " sub-allocations; "
+			  << "peak " << allocation_stats.peak_blocks << " blocks, " << MB(allocation_stats.peak_reserved) << " reserved, "
+			  << MB(allocation_stats.peak_used) << " used." << std::endl;
+
+	for (MemoryBlock const &block : memory_blocks)
+	{
+		if (block.allocations == 0)
+			continue;
+		std::cout << "  still allocated: " << block.allocations << " allocation(s), " << block.used << " bytes in " << (block.dedicated ? "dedicated" : "shared")
+				  << " block of memory type " << block.memory_type_index << "." << std::endl;
+	}
 }
 
 //----------------------------
@@ -138,11 +333,12 @@ void Helpers::destroy_buffer(AllocatedBuffer &&buffer)
 	this->free(std::move(buffer.allocation));
 }
 
-Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map)
+Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map, uint32_t mip_levels)
 {
 	AllocatedImage image;
 	image.extent = extent;
 	image.format = format;
+	image.mip_levels = mip_levels;
 
 	VkImageCreateInfo create_info{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -152,7 +348,7 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 			.width = extent.width,
 			.height = extent.height,
 			.depth = 1},
-		.mipLevels = 1,
+		.mipLevels = mip_levels,
 		.arrayLayers = 1,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = tiling,
@@ -163,10 +359,33 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 
 	VK(vkCreateImage(rtg.device, &create_info, nullptr, &image.handle));
 
-	VkMemoryRequirements req;
-	vkGetImageMemoryRequirements(rtg.device, image.handle, &req);
+	VkMemoryDedicatedRequirements dedicated_req{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+	};
+	VkMemoryRequirements2 req2{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+		.pNext = &dedicated_req,
+	};
+	VkImageMemoryRequirementsInfo2 info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+		.image = image.handle,
+	};
+	vkGetImageMemoryRequirements2(rtg.device, &info, &req2);
+	VkMemoryRequirements const &req = req2.memoryRequirements;
 
-	image.allocation = allocate(req, properties, map);
+	uint32_t memory_type_index = find_memory_type(req.memoryTypeBits, properties);
+	if (dedicated_req.prefersDedicatedAllocation || dedicated_req.requiresDedicatedAllocation || req.size >= DedicatedImageSize)
+	{
+		// (render targets and other large images; lets the driver place them optimally)
+		image.allocation = allocate_dedicated(req.size, memory_type_index, map, image.handle);
+	}
+	else
+	{
+		// pad to bufferImageGranularity on both ends so the image never shares a "page" with a buffer in the same block:
+		VkDeviceSize alignment = std::max(req.alignment, buffer_image_granularity);
+		VkDeviceSize size = (req.size + buffer_image_granularity - 1) / buffer_image_granularity * buffer_image_granularity;
+		image.allocation = allocate(size, alignment, memory_type_index, map);
+	}
 
 	VK(vkBindImageMemory(rtg.device, image.handle, image.allocation.handle, image.allocation.offset));
 	return image;
@@ -187,79 +406,118 @@ void Helpers::destroy_image(AllocatedImage &&image)
 
 void Helpers::transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target)
 {
-	// NOTE: could let this stick around and use it for all uploads, but this function isn't for performant transfers anyway:
-	AllocatedBuffer transfer_src = create_buffer(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		Mapped);
+	queue_upload(data, size, target);
+	wait_for_uploads(submit_uploads());
+}
 
-	// copy data into transfer buffer:
-	std::memcpy(transfer_src.allocation.data(), data, size);
+void Helpers::transfer_buffer_to_buffer(AllocatedBuffer const &source, AllocatedBuffer &target, size_t size)
+{
+	assert(source.handle && target.handle);			// buffers should be allocated already
+	assert(size <= source.size && size <= target.size); // copy should fit in both
+
+	// (source stays owned by the caller, so this has to wait before returning)
+	VkCommandBuffer commands = begin_upload();
+	VkBufferCopy copy_region{
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size};
+	vkCmdCopyBuffer(commands, source.handle, target.handle, 1, &copy_region);
+	release_buffer(target);
+
+	wait_for_uploads(submit_uploads());
+}
 
-	{ // record command buffer that does CPU->GPU transfer:
-		VK(vkResetCommandBuffer(transfer_command_buffer, 0));
+void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
+{
+	queue_upload(data, size, target);
+	wait_for_uploads(submit_uploads());
+}
+
+//----------------------------
+
+VkCommandBuffer Helpers::begin_upload()
+{
+	if (recording.transfer_commands == VK_NULL_HANDLE)
+	{
+		VkCommandBufferAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = upload_command_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+		VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &recording.transfer_commands));
 
 		VkCommandBufferBeginInfo begin_info{
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // will record again every submit
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 		};
+		VK(vkBeginCommandBuffer(recording.transfer_commands, &begin_info));
+	}
+	return recording.transfer_commands;
+}
 
-		VK(vkBeginCommandBuffer(transfer_command_buffer, &begin_info));
+void Helpers::release_buffer(AllocatedBuffer const &target)
+{
+	// (submit_uploads clears the queue family indices if both families are the same)
+	recording.buffer_barriers.emplace_back(VkBufferMemoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+		.srcQueueFamilyIndex = rtg.transfer_queue_family.value(),
+		.dstQueueFamilyIndex = rtg.graphics_queue_family.value(),
+		.buffer = target.handle,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	});
+}
 
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = size};
-		vkCmdCopyBuffer(transfer_command_buffer, transfer_src.handle, target.handle, 1, &copy_region);
+void Helpers::queue_upload(void const *data, size_t size, AllocatedBuffer &target)
+{
+	AllocatedBuffer staging = create_buffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		Mapped);
 
-		VK(vkEndCommandBuffer(transfer_command_buffer));
-	}
+	std::memcpy(staging.allocation.data(), data, size);
 
-	{ // run command buffer
-		VkSubmitInfo submit_info{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &transfer_command_buffer};
+	queue_upload(std::move(staging), size, target);
+}
 
-		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-	}
+void Helpers::queue_upload(AllocatedBuffer &&staging, size_t size, AllocatedBuffer &target)
+{
+	assert(staging.handle && target.handle);			 // buffers should be allocated already
+	assert(size <= staging.size && size <= target.size); // copy should fit in both
+
+	VkCommandBuffer commands = begin_upload();
 
-	// wait for command buffer to finish
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+	VkBufferCopy copy_region{
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size};
+	vkCmdCopyBuffer(commands, staging.handle, target.handle, 1, &copy_region);
 
-	// don't leak buffer memory:
-	destroy_buffer(std::move(transfer_src));
+	release_buffer(target);
+	recording.staging.emplace_back(std::move(staging));
 }
 
-void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
+void Helpers::queue_upload(void const *data, size_t size, AllocatedImage &target)
 {
 	assert(target.handle); // target image should be allocated already
 
 	// check data is the right size:
-	//[[maybe_unused]] size_t bytes_per_pixel = (target.format);
 	[[maybe_unused]] size_t bytes_per_pixel = get_bytes_per_pixel(target.format);
 	assert(size == target.extent.width * target.extent.height * bytes_per_pixel);
 
-	// create a host-coherent source buffer
-	AllocatedBuffer transfer_src = create_buffer(
+	AllocatedBuffer staging = create_buffer(
 		size,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		Mapped);
 
-	// copy image data into the source buffer
-	std::memcpy(transfer_src.allocation.data(), data, size);
+	std::memcpy(staging.allocation.data(), data, size);
 
-	// begin recording a command buffer
-	VK(vkResetCommandBuffer(transfer_command_buffer, 0));
-
-	VkCommandBufferBeginInfo begin_info{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // will record again every submit
-	};
-
-	VK(vkBeginCommandBuffer(transfer_command_buffer, &begin_info));
+	VkCommandBuffer commands = begin_upload();
 
 	VkImageSubresourceRange whole_image{
 		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -283,7 +541,7 @@ void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
 		};
 
 		vkCmdPipelineBarrier(
-			transfer_command_buffer,		   // commandBuffer
+			commands,						   // commandBuffer
 			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
 			VK_PIPELINE_STAGE_TRANSFER_BIT,	   // dstStageMask
 			0,								   // dependencyFlags
@@ -312,8 +570,8 @@ void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
 		};
 
 		vkCmdCopyBufferToImage(
-			transfer_command_buffer,
-			transfer_src.handle,
+			commands,
+			staging.handle,
 			target.handle,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1, &region);
@@ -321,45 +579,275 @@ void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
 		// NOTE: if image had mip levels, would need to copy as additional regions here.
 	}
 
-	{ // transition the image memory to shader-read-only-optimal layout:
-		VkImageMemoryBarrier barrier{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = target.handle,
-			.subresourceRange = whole_image,
+	// transition to shader-read-only-optimal layout (and graphics queue ownership) at submit time:
+	recording.image_barriers.emplace_back(VkImageMemoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = rtg.transfer_queue_family.value(),
+		.dstQueueFamilyIndex = rtg.graphics_queue_family.value(),
+		.image = target.handle,
+		.subresourceRange = whole_image,
+	});
+
+	recording.staging.emplace_back(std::move(staging));
+}
+
+uint64_t Helpers::submit_uploads()
+{
+	if (recording.transfer_commands == VK_NULL_HANDLE)
+		return upload_timeline_value; // nothing queued
+
+	UploadBatch batch = std::move(recording);
+	recording = UploadBatch();
+
+	bool ownership_transfer = (rtg.transfer_queue_family.value() != rtg.graphics_queue_family.value());
+
+	if (!ownership_transfer)
+	{
+		// same queue: one barrier makes the copies visible to everything submitted later:
+		for (auto &barrier : batch.buffer_barriers)
+		{
+			barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		for (auto &barrier : batch.image_barriers)
+		{
+			barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		vkCmdPipelineBarrier(
+			batch.transfer_commands,									   // commandBuffer
+			VK_PIPELINE_STAGE_TRANSFER_BIT,								   // srcStageMask
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,							   // dstStageMask
+			0,															   // dependencyFlags
+			0, nullptr,													   // memory barrier count, pointer
+			uint32_t(batch.buffer_barriers.size()), batch.buffer_barriers.data(), // buffer memory barrier count, pointer
+			uint32_t(batch.image_barriers.size()), batch.image_barriers.data()	   // image memory barrier count, pointer
+		);
+	}
+	else
+	{
+		// release on the transfer queue (destination access is ignored there):
+		std::vector<VkBufferMemoryBarrier> buffer_releases = batch.buffer_barriers;
+		std::vector<VkImageMemoryBarrier> image_releases = batch.image_barriers;
+		for (auto &barrier : buffer_releases)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		for (auto &barrier : image_releases)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(
+			batch.transfer_commands,								 // commandBuffer
+			VK_PIPELINE_STAGE_TRANSFER_BIT,							 // srcStageMask
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,					 // dstStageMask
+			0,														 // dependencyFlags
+			0, nullptr,												 // memory barrier count, pointer
+			uint32_t(buffer_releases.size()), buffer_releases.data(), // buffer memory barrier count, pointer
+			uint32_t(image_releases.size()), image_releases.data()	 // image memory barrier count, pointer
+		);
+
+		// ...and a matching acquire on the graphics queue (source access is ignored there):
+		VkCommandBufferAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = transfer_command_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
 		};
+		VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &batch.acquire_commands));
 
+		VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+		VK(vkBeginCommandBuffer(batch.acquire_commands, &begin_info));
+		for (auto &barrier : batch.buffer_barriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+		for (auto &barrier : batch.image_barriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
 		vkCmdPipelineBarrier(
-			transfer_command_buffer,			   // commandBuffer
-			VK_PIPELINE_STAGE_TRANSFER_BIT,		   // srcStageMask
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
-			0,									   // dependencyFlags
-			0, nullptr,							   // memory barrier count, pointer
-			0, nullptr,							   // buffer memory barrier count, pointer
-			1, &barrier							   // image memory barrier count, pointer
+			batch.acquire_commands,												  // commandBuffer
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,									  // srcStageMask
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,									  // dstStageMask
+			0,																	  // dependencyFlags
+			0, nullptr,															  // memory barrier count, pointer
+			uint32_t(batch.buffer_barriers.size()), batch.buffer_barriers.data(), // buffer memory barrier count, pointer
+			uint32_t(batch.image_barriers.size()), batch.image_barriers.data()	  // image memory barrier count, pointer
 		);
+		VK(vkEndCommandBuffer(batch.acquire_commands));
 	}
 
-	// end and submit the command buffer
-	VK(vkEndCommandBuffer(transfer_command_buffer));
+	VK(vkEndCommandBuffer(batch.transfer_commands));
+
+	{ // copies signal upload_timeline when done:
+		uint64_t copied_value = ++upload_timeline_value;
+		VkTimelineSemaphoreSubmitInfo timeline_info{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &copied_value,
+		};
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timeline_info,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.transfer_commands,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &upload_timeline,
+		};
+		VK(vkQueueSubmit(rtg.transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+	}
+
+	if (batch.acquire_commands != VK_NULL_HANDLE)
+	{ // the graphics queue waits (on the GPU) for the copies, acquires ownership, then signals the next value:
+		uint64_t copied_value = upload_timeline_value;
+		uint64_t acquired_value = ++upload_timeline_value;
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkTimelineSemaphoreSubmitInfo timeline_info{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = 1,
+			.pWaitSemaphoreValues = &copied_value,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &acquired_value,
+		};
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timeline_info,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &upload_timeline,
+			.pWaitDstStageMask = &wait_stage,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.acquire_commands,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &upload_timeline,
+		};
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	}
 
-	VkSubmitInfo submit_info{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &transfer_command_buffer};
+	batch.done_value = upload_timeline_value;
+	batch.buffer_barriers.clear();
+	batch.image_barriers.clear();
+	uploading.emplace_back(std::move(batch));
 
-	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	return upload_timeline_value;
+}
 
-	// wait for command buffer to finish executing
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+void Helpers::wait_for_uploads(uint64_t value)
+{
+	VkSemaphoreWaitInfo wait_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &upload_timeline,
+		.pValues = &value,
+	};
+	VK(vkWaitSemaphores(rtg.device, &wait_info, UINT64_MAX));
 
-	// destroy the source buffer
-	destroy_buffer(std::move(transfer_src));
+	retire_uploads();
+}
+
+void Helpers::retire_uploads()
+{
+	if (uploading.empty())
+		return;
+
+	uint64_t done = 0;
+	VK(vkGetSemaphoreCounterValue(rtg.device, upload_timeline, &done));
+
+	// batches finish in submission order:
+	size_t finished = 0;
+	while (finished < uploading.size() && uploading[finished].done_value <= done)
+	{
+		UploadBatch &batch = uploading[finished];
+		for (AllocatedBuffer &staging : batch.staging)
+		{
+			destroy_buffer(std::move(staging));
+		}
+		vkFreeCommandBuffers(rtg.device, upload_command_pool, 1, &batch.transfer_commands);
+		if (batch.acquire_commands != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(rtg.device, transfer_command_pool, 1, &batch.acquire_commands);
+		}
+		++finished;
+	}
+	uploading.erase(uploading.begin(), uploading.begin() + finished);
+}
+
+//----------------------------
+
+void Helpers::begin_frame_uploads(uint32_t workspace_index, VkDeviceSize bytes)
+{
+	assert(workspace_index < rtg.configuration.workspaces);
+
+	if (staging_ring.handle == VK_NULL_HANDLE || staging_partition < bytes)
+	{
+		// grow geometrically (and in 64k steps) so this only happens a handful of times:
+		VkDeviceSize new_partition = std::max<VkDeviceSize>(bytes, 2 * staging_partition);
+		new_partition = (new_partition + 0xffff) & ~VkDeviceSize(0xffff);
+
+		if (staging_ring.handle != VK_NULL_HANDLE)
+		{
+			// other partitions may still be read by in-flight frames:
+			VK(vkDeviceWaitIdle(rtg.device));
+			destroy_buffer(std::move(staging_ring));
+		}
+
+		staging_ring = create_buffer(
+			new_partition * rtg.configuration.workspaces,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// going to have GPU copy from this memory
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
+			Mapped																		// persistently mapped
+		);
+		staging_partition = new_partition;
+
+		if (rtg.configuration.debug)
+		{
+			std::cout << "Staging ring is now " << rtg.configuration.workspaces << " x " << staging_partition << " bytes." << std::endl;
+		}
+	}
+
+	staging_workspace = workspace_index;
+	staging_used = 0;
+	staging_regions.clear();
+}
+
+void *Helpers::stage(VkDeviceSize size, VkDeviceSize dst_offset)
+{
+	assert(staging_ring.allocation.mapped);
+
+	if (staging_used + size > staging_partition)
+	{
+		throw std::runtime_error("Staged " + std::to_string(staging_used + size) + " bytes, but begin_frame_uploads reserved only " + std::to_string(staging_partition) + ".");
+	}
+
+	VkDeviceSize src_offset = staging_workspace * staging_partition + staging_used;
+	staging_used += (size + StagingAlignment - 1) & ~(StagingAlignment - 1);
+
+	staging_regions.emplace_back(VkBufferCopy{
+		.srcOffset = src_offset,
+		.dstOffset = dst_offset,
+		.size = size,
+	});
+
+	return reinterpret_cast<char *>(staging_ring.allocation.data()) + src_offset;
+}
+
+void Helpers::stage(void const *data, VkDeviceSize size, VkDeviceSize dst_offset)
+{
+	std::memcpy(stage(size, dst_offset), data, size_t(size));
+}
+
+void Helpers::record_frame_uploads(VkCommandBuffer command_buffer, AllocatedBuffer const &target)
+{
+	if (staging_regions.empty())
+		return;
+
+	vkCmdCopyBuffer(command_buffer, staging_ring.handle, target.handle, uint32_t(staging_regions.size()), staging_regions.data());
+	staging_regions.clear();
 }
 
 //----------------------------
@@ -418,23 +906,40 @@ Helpers::~Helpers()
 
 void Helpers::create()
 {
-	VkCommandPoolCreateInfo create_info{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-		.queueFamilyIndex = rtg.graphics_queue_family.value(),
-	};
-	VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &transfer_command_pool));
+	{ // command pools for upload batches (upload_command_pool) and their graphics-side acquires (transfer_command_pool):
+		VkCommandPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = rtg.graphics_queue_family.value(),
+		};
+		VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &transfer_command_pool));
 
-	VkCommandBufferAllocateInfo alloc_info{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = transfer_command_pool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1,
-	};
-	VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &transfer_command_buffer));
+		create_info.queueFamilyIndex = rtg.transfer_queue_family.value();
+		VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &upload_command_pool));
+	}
+
+	{ // timeline semaphore signaled by upload batches:
+		VkSemaphoreTypeCreateInfo type_info{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = 0,
+		};
+		VkSemaphoreCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &type_info,
+		};
+		VK(vkCreateSemaphore(rtg.device, &create_info, nullptr, &upload_timeline));
+		upload_timeline_value = 0;
+	}
 
 	vkGetPhysicalDeviceMemoryProperties(rtg.physical_device, &memory_properties);
 
+	{ // linear (buffer) and optimal (image) resources in the same memory must be this far apart:
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(rtg.physical_device, &properties);
+		buffer_image_granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	}
+
 	if (rtg.configuration.debug)
 	{
 		std::cout << "Memory types: ";
@@ -455,11 +960,41 @@ void Helpers::create()
 
 void Helpers::destroy()
 {
-	// technically not needed since freeing the pool will free all contained buffers:
-	if (transfer_command_buffer != VK_NULL_HANDLE)
+	if (recording.transfer_commands != VK_NULL_HANDLE)
+	{
+		// (uploads queued but never submitted still have to be cleaned up)
+		submit_uploads();
+	}
+	if (upload_timeline != VK_NULL_HANDLE)
+	{
+		wait_for_uploads(upload_timeline_value);
+		vkDestroySemaphore(rtg.device, upload_timeline, nullptr);
+		upload_timeline = VK_NULL_HANDLE;
+	}
+
+	if (staging_ring.handle != VK_NULL_HANDLE)
+	{
+		destroy_buffer(std::move(staging_ring));
+		staging_partition = 0;
+	}
+
+	report_allocation_stats();
+
+	// what's left should just be (empty) blocks kept around for reuse:
+	for (MemoryBlock &block : memory_blocks)
+	{
+		if (block.mapped != nullptr)
+		{
+			vkUnmapMemory(rtg.device, block.handle);
+		}
+		vkFreeMemory(rtg.device, block.handle, nullptr);
+	}
+	memory_blocks.clear();
+
+	if (upload_command_pool != VK_NULL_HANDLE)
 	{
-		vkFreeCommandBuffers(rtg.device, transfer_command_pool, 1, &transfer_command_buffer);
-		transfer_command_buffer = VK_NULL_HANDLE;
+		vkDestroyCommandPool(rtg.device, upload_command_pool, nullptr);
+		upload_command_pool = VK_NULL_HANDLE;
 	}
 
 	if (transfer_command_pool != VK_NULL_HANDLE)
@@ -43,6 +43,48 @@ struct Helpers
 	// free an allocated block:
 	void free(Allocation &&allocation);
 
+	// allocations are sub-allocated from large per-memory-type blocks of device memory (so 'handle' is shared
+	//  and 'offset' is usually non-zero); requests bigger than half a block get a VkDeviceMemory of their own:
+	struct MemoryBlock
+	{
+		VkDeviceMemory handle = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memory_type_index = 0;
+		bool dedicated = false; // holds exactly one allocation, and is freed along with it
+		void *mapped = nullptr; // whole block is mapped (once) by the first Mapped allocation made from it
+
+		struct Range
+		{
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+		};
+		std::vector<Range> free_ranges; // sorted by offset; adjacent ranges are always merged
+		uint32_t allocations = 0;		// live allocations in this block
+		VkDeviceSize used = 0;			// bytes covered by live allocations
+	};
+	std::vector<MemoryBlock> memory_blocks;
+
+	static constexpr VkDeviceSize DefaultBlockSize = 64 * 1024 * 1024; // (smaller for small heaps, see block_size_for)
+	static constexpr VkDeviceSize DedicatedImageSize = 16 * 1024 * 1024; // images at least this big always get dedicated memory
+	VkDeviceSize buffer_image_granularity = 1;							 // from VkPhysicalDeviceLimits; images are padded to this
+	VkDeviceSize block_size_for(uint32_t memory_type_index) const;
+
+	// allocate a VkDeviceMemory for just this request (if 'image' is set, as a VkMemoryDedicatedAllocateInfo for it):
+	Allocation allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index, MapFlag map, VkImage image = VK_NULL_HANDLE);
+
+	struct AllocationStats
+	{
+		uint64_t device_allocations = 0;	// vkAllocateMemory calls
+		uint64_t dedicated_allocations = 0; // ...of which were dedicated / oversized requests
+		uint64_t sub_allocations = 0;		// allocate() calls served from a shared block
+		uint32_t peak_blocks = 0;			// most VkDeviceMemory objects alive at once
+		VkDeviceSize peak_reserved = 0;		// most bytes of device memory held at once
+		VkDeviceSize peak_used = 0;			// most bytes handed out to allocations at once
+		VkDeviceSize reserved = 0;			// current bytes of device memory held
+		VkDeviceSize used = 0;				// current bytes handed out
+	} allocation_stats;
+	void report_allocation_stats() const; // print allocation_stats and per-block usage (called by destroy())
+
 	// specializations that also create a buffer or image (respectively):
 	struct AllocatedBuffer
 	{
@@ -60,23 +102,84 @@ struct Helpers
 		VkImage handle = VK_NULL_HANDLE;
 		VkExtent2D extent{.width = 0, .height = 0};
 		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mip_levels = 1;
 		Allocation allocation;
 
 		// NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
 	};
 
-	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped, uint32_t mip_levels = 1);
 	void destroy_image(AllocatedImage &&allocated_image);
 
 	//-----------------------
 	// CPU -> GPU data transfer:
 
-	// NOTE: synchronizes *hard* against the GPU; inefficient to use for streaming data!
+	// NOTE: waits (on the CPU) for the upload to finish; prefer the batched queue_upload calls below:
 	void transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target);
 	void transfer_to_image(void *data, size_t size, AllocatedImage &image); // NOTE: image layout after call is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	// copy from an already-filled (e.g., mapped staging) buffer, without another CPU-side copy:
+	void transfer_buffer_to_buffer(AllocatedBuffer const &source, AllocatedBuffer &target, size_t size);
+
+	//-----------------------
+	// Batched asynchronous CPU -> GPU uploads:
+	//  queue_upload records copies from (internally managed) staging buffers into one command buffer;
+	//  submit_uploads sends the batch to rtg.transfer_queue and returns the upload_timeline value that marks its completion.
+	//  Ownership is handed to the graphics queue family (with a GPU-side wait), so anything submitted to
+	//  rtg.graphics_queue afterward sees the data without the CPU ever waiting.
+
+	void queue_upload(void const *data, size_t size, AllocatedBuffer &target);
+	void queue_upload(AllocatedBuffer &&staging, size_t size, AllocatedBuffer &target); // takes ownership of an already-filled, mapped staging buffer
+	void queue_upload(void const *data, size_t size, AllocatedImage &target);			// image layout after upload is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+
+	uint64_t submit_uploads();			   // submit everything queued so far (returns the last submitted value if nothing was queued)
+	void wait_for_uploads(uint64_t value); // block until upload_timeline reaches value, then retire_uploads()
+	void retire_uploads();				   // free staging memory of finished batches (cheap; called once per frame by RTG::run)
+
+	VkSemaphore upload_timeline = VK_NULL_HANDLE; // timeline semaphore signaled as upload batches finish
+	uint64_t upload_timeline_value = 0;			  // last value a submitted batch will signal
+
+	struct UploadBatch
+	{
+		uint64_t done_value = 0; // batch is finished once upload_timeline reaches this
+		// copies + release barriers (from upload_command_pool):
+		VkCommandBuffer transfer_commands = VK_NULL_HANDLE;
+		// acquire barriers, if the transfer queue family differs (from transfer_command_pool):
+		VkCommandBuffer acquire_commands = VK_NULL_HANDLE;
+		// source buffers to free once done:
+		std::vector<AllocatedBuffer> staging;
+		// ownership / layout barriers, recorded at submit time:
+		std::vector<VkBufferMemoryBarrier> buffer_barriers;
+		std::vector<VkImageMemoryBarrier> image_barriers;
+	};
+	UploadBatch recording;				// batch being recorded (transfer_commands is null until the first queue_upload)
+	std::vector<UploadBatch> uploading; // submitted batches, in submission order
+
+	VkCommandPool upload_command_pool = VK_NULL_HANDLE;	  // on rtg.transfer_queue_family
+	VkCommandPool transfer_command_pool = VK_NULL_HANDLE; // on rtg.graphics_queue_family
+
+	VkCommandBuffer begin_upload();						   // (starts recording.transfer_commands if needed)
+	void release_buffer(AllocatedBuffer const &target); // hand a just-written buffer to the graphics queue at submit time
+
+	//-----------------------
+	// Per-frame streaming through a persistently mapped staging ring:
+	//  the ring is split into one partition per workspace, so a partition is only rewritten once the
+	//  workspace's previous frame has finished (RTG::run waits on its fence before calling render).
+	//  begin_frame_uploads resets (and, rarely, grows) a partition; stage sub-allocates from it and
+	//  remembers a copy region; record_frame_uploads issues every region as a single vkCmdCopyBuffer.
+
+	void begin_frame_uploads(uint32_t workspace_index, VkDeviceSize bytes); // bytes: upper bound on what will be staged this frame
+	void *stage(VkDeviceSize size, VkDeviceSize dst_offset);				  // returns mapped memory to fill with 'size' bytes
+	void stage(void const *data, VkDeviceSize size, VkDeviceSize dst_offset); // (copies 'data' into the ring)
+	void record_frame_uploads(VkCommandBuffer command_buffer, AllocatedBuffer const &target);
+
+	static constexpr VkDeviceSize StagingAlignment = 16; // alignment of each staged block inside the ring
+
+	AllocatedBuffer staging_ring;					// host visible, coherent, mapped; staging_partition bytes per workspace
+	VkDeviceSize staging_partition = 0;				// bytes per workspace partition
+	uint32_t staging_workspace = 0;					// partition currently being filled
+	VkDeviceSize staging_used = 0;					// bytes used in that partition
+	std::vector<VkBufferCopy> staging_regions;		// copies recorded by stage() since begin_frame_uploads()
 
-	VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
-	VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
 	//-----------------------
 	// Misc utilities:
 
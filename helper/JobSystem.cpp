@@ -0,0 +1,173 @@
+#include "JobSystem.hpp"
+
+#include <iostream>
+#include <system_error>
+
+// (lets a worker thread find its own queue when it calls parallel_for from inside a task)
+static thread_local JobSystem const *current_pool = nullptr;
+static thread_local uint32_t current_queue = 0;
+
+JobSystem::JobSystem(uint32_t threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	queues.reserve(threads);
+	for (uint32_t q = 0; q < threads; ++q)
+	{
+		queues.emplace_back(std::make_unique<Queue>());
+	}
+
+	workers.reserve(threads - 1);
+	try
+	{
+		for (uint32_t q = 1; q < threads; ++q)
+		{
+			workers.emplace_back(&JobSystem::worker_main, this, q);
+		}
+	}
+	catch (std::system_error const &e)
+	{
+		// couldn't start (all of) the workers; loops will just be spread over fewer threads:
+		std::cerr << "Job system running with " << workers.size() + 1 << " threads: " << e.what() << std::endl;
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::queue_index() const
+{
+	return current_pool == this ? current_queue : 0;
+}
+
+void JobSystem::run(Loop &loop)
+{
+	uint32_t queue = queue_index();
+	push(queue, Task{.loop = &loop, .begin = 0, .end = loop.remaining.load()});
+
+	// help out (with this loop or anything else queued) until every index of this loop is finished:
+	while (loop.remaining.load(std::memory_order_acquire) > 0)
+	{
+		Task task;
+		if (take(queue, &task))
+		{
+			execute(queue, task);
+		}
+		else
+		{
+			std::this_thread::yield(); // (the last pieces are running elsewhere)
+		}
+	}
+
+	if (loop.error)
+	{
+		std::rethrow_exception(loop.error);
+	}
+}
+
+void JobSystem::push(uint32_t queue, Task const &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->tasks.emplace_back(task);
+	}
+	queued.fetch_add(1, std::memory_order_release);
+	{
+		// (taking the lock orders this with a worker's check of 'queued' before it sleeps, so the wakeup isn't lost)
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::take(uint32_t queue, Task *task)
+{
+	if (queued.load(std::memory_order_acquire) == 0)
+		return false;
+
+	// newest (smallest, most cache-warm) task from our own queue:
+	{
+		Queue &own = *queues[queue];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			*task = own.tasks.back();
+			own.tasks.pop_back();
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// otherwise the oldest (biggest) task from someone else's:
+	uint32_t count = uint32_t(queues.size());
+	for (uint32_t offset = 1; offset < count; ++offset)
+	{
+		Queue &other = *queues[(queue + offset) % count];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.tasks.empty())
+		{
+			*task = other.tasks.front();
+			other.tasks.pop_front();
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(uint32_t queue, Task task)
+{
+	Loop &loop = *task.loop;
+	while (task.end - task.begin > loop.grain)
+	{
+		size_t middle = task.begin + (task.end - task.begin) / 2;
+		push(queue, Task{.loop = &loop, .begin = middle, .end = task.end});
+		task.end = middle;
+	}
+
+	try
+	{
+		loop.body(loop.context, task.begin, task.end);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(loop.error_mutex);
+		if (!loop.error)
+			loop.error = std::current_exception();
+	}
+
+	// (after this, the loop's owner may return and 'loop' may be gone)
+	loop.remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+}
+
+void JobSystem::worker_main(uint32_t queue)
+{
+	current_pool = this;
+	current_queue = queue;
+
+	while (true)
+	{
+		Task task;
+		if (take(queue, &task))
+		{
+			execute(queue, task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [&]()
+				  { return quit || queued.load(std::memory_order_acquire) > 0; });
+		if (quit && queued.load() == 0)
+			return;
+	}
+}
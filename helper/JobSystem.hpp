@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small work-stealing thread pool for data-parallel loops:
+//  parallel_for puts its whole range on the calling thread's queue as one task. Whoever runs a task longer
+//  than 'grain' first splits off its upper half onto their own queue (so queues fill with big pieces at the
+//  front and small ones at the back); threads pop from the back of their own queue and, when it is empty,
+//  steal from the front of someone else's. The calling thread works on its loop too, until the loop is done.
+struct JobSystem
+{
+	explicit JobSystem(uint32_t threads = 0); // total threads, counting the caller (0: one per hardware thread)
+	JobSystem(JobSystem const &) = delete;	  // you shouldn't be copying a JobSystem
+	~JobSystem();							  // finishes queued work, then joins the workers
+
+	uint32_t thread_count() const { return uint32_t(workers.size()) + 1; }
+
+	// call fn(begin, end) on disjoint ranges that together cover [0, count), none longer than 'grain'
+	//  (grain 0: a few ranges per thread); returns once every call has; rethrows the first exception fn threw:
+	template <typename Fn>
+	void parallel_for(size_t count, size_t grain, Fn const &fn)
+	{
+		if (grain == 0)
+			grain = std::max<size_t>(1, count / (4 * thread_count()));
+		if (count == 0)
+			return;
+		if (workers.empty() || count <= grain)
+		{
+			for (size_t begin = 0; begin < count; begin += grain)
+			{
+				fn(begin, std::min(count, begin + grain));
+			}
+			return;
+		}
+		Loop loop;
+		loop.body = [](void const *context, size_t begin, size_t end)
+		{ (*reinterpret_cast<Fn const *>(context))(begin, end); };
+		loop.context = &fn;
+		loop.grain = grain;
+		loop.remaining = count;
+		run(loop);
+	}
+
+	//-----------------------
+	// internals:
+
+	struct Loop
+	{
+		void (*body)(void const *context, size_t begin, size_t end) = nullptr;
+		void const *context = nullptr;
+		size_t grain = 1;
+		std::atomic<size_t> remaining{0}; // indices not finished yet (the loop is done at zero)
+		std::mutex error_mutex;
+		std::exception_ptr error; // first exception thrown by body
+	};
+	struct Task
+	{
+		Loop *loop = nullptr;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Queue>> queues; // [0] is shared by threads outside the pool, [1 + i] belongs to workers[i]
+	std::atomic<uint32_t> queued{0};			// tasks waiting in any queue (idle workers sleep while this is zero)
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool quit = false; // (guarded by sleep_mutex)
+
+	void run(Loop &loop);						 // queue the loop's whole range, then help until it is done
+	void push(uint32_t queue, Task const &task); // (and wake a sleeping worker)
+	bool take(uint32_t queue, Task *task);		 // pop from the back of our own queue, else steal from the front of another
+	void execute(uint32_t queue, Task task);	 // split down to grain (queueing the rest), run, count down
+	void worker_main(uint32_t queue);
+	uint32_t queue_index() const; // queue belonging to the calling thread
+};
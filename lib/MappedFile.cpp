@@ -0,0 +1,125 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile &&from)
+{
+    *this = std::move(from);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&from)
+{
+    if (this == &from)
+        return *this;
+
+    unmap();
+
+    std::swap(data, from.data);
+    std::swap(size, from.size);
+#if defined(_WIN32)
+    std::swap(file_handle, from.file_handle);
+    std::swap(mapping_handle, from.mapping_handle);
+#endif
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+bool MappedFile::map(std::string const &path)
+{
+    unmap();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = file;
+    size = size_t(file_size.QuadPart);
+    if (size == 0)
+        return true; // nothing to map (CreateFileMapping rejects empty files)
+
+    mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle)
+    {
+        data = reinterpret_cast<char const *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!data)
+    {
+        unmap();
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size = size_t(info.st_size);
+    if (size != 0)
+    {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            size = 0;
+            return false;
+        }
+        // data is read front-to-back exactly once:
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = reinterpret_cast<char const *>(mapped);
+    }
+
+    // the mapping stays valid after the descriptor is closed:
+    close(fd);
+#endif
+
+    return true;
+}
+
+void MappedFile::unmap()
+{
+#if defined(_WIN32)
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (data)
+        munmap(const_cast<char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
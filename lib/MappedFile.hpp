@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A read-only memory mapping of a whole file.
+//  Used to decode .b72 data in place, without copying it through a stream first.
+struct MappedFile
+{
+    MappedFile() = default;
+    MappedFile(MappedFile const &) = delete; // owns the mapping, don't copy
+    MappedFile &operator=(MappedFile const &) = delete;
+    MappedFile(MappedFile &&);            // takes over the mapping of the moved-from file
+    MappedFile &operator=(MappedFile &&); // unmaps any current mapping first
+    ~MappedFile();                        // unmaps
+
+    // map the file at 'path'; returns false (and leaves the file unmapped) on failure:
+    bool map(std::string const &path);
+    void unmap();
+
+    char const *data = nullptr;
+    size_t size = 0;
+
+private:
+#if defined(_WIN32)
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#endif
+};
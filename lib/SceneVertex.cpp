@@ -1,63 +1,197 @@
 #include "SceneVertex.hpp"
 
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
 
-std::pair<std::vector<VkVertexInputBindingDescription>, std::vector<VkVertexInputAttributeDescription>> SceneVertex::get_binding_and_attribute_descriptions(bool useColor)
+SceneAttributes SceneAttributes::from(SceneVertex const &vertex)
 {
-    std::vector<VkVertexInputBindingDescription> bindings = {
-        VkVertexInputBindingDescription{
-            .binding = 0,
-            .stride = sizeof(SceneVertex),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}};
-
-    std::vector<VkVertexInputAttributeDescription> attributes = {
-        VkVertexInputAttributeDescription{
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = offsetof(SceneVertex, Position)},
-        VkVertexInputAttributeDescription{
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = offsetof(SceneVertex, Normal),
-        },
-        VkVertexInputAttributeDescription{
-            .location = 2,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-            .offset = offsetof(SceneVertex, Tangent),
-        },
-        VkVertexInputAttributeDescription{
-            .location = 3,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(SceneVertex, TexCoord),
-        },
-    };
-
-    if (useColor)
-    {
-        attributes.push_back(VkVertexInputAttributeDescription{
-            .location = 4,
-            .binding = 0,
-            .format = VK_FORMAT_R8G8B8A8_UNORM,
-            .offset = offsetof(SceneVertex, color)});
+    SceneAttributes attributes;
+
+    attributes.Normal.x = vertex.Normal.x;
+    attributes.Normal.y = vertex.Normal.y;
+    attributes.Normal.z = vertex.Normal.z;
+
+    attributes.Tangent.x = vertex.Tangent.x;
+    attributes.Tangent.y = vertex.Tangent.y;
+    attributes.Tangent.z = vertex.Tangent.z;
+    attributes.Tangent.w = vertex.Tangent.w;
+
+    attributes.TexCoord.s = vertex.TexCoord.s;
+    attributes.TexCoord.t = vertex.TexCoord.t;
+
+    attributes.color = vertex.color.value_or(Color{255, 255, 255, 255});
+
+    return attributes;
+}
+
+PackedSceneAttributes PackedSceneAttributes::pack(SceneVertex const &vertex)
+{
+    PackedSceneAttributes packed;
+
+    { // octahedral normal: project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half over the upper:
+        glm::vec3 n(vertex.Normal.x, vertex.Normal.y, vertex.Normal.z);
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        glm::vec2 e(0.0f);
+        if (l1 > 0.0f)
+        {
+            e = glm::vec2(n.x, n.y) / l1;
+            if (n.z < 0.0f)
+            {
+                e = glm::vec2(
+                    (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                    (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+            }
+        }
+        packed.Normal.x = int16_t(glm::packSnorm1x16(e.x));
+        packed.Normal.y = int16_t(glm::packSnorm1x16(e.y));
     }
 
-    return {bindings, attributes};
+    packed.Tangent.x = int16_t(glm::packSnorm1x16(vertex.Tangent.x));
+    packed.Tangent.y = int16_t(glm::packSnorm1x16(vertex.Tangent.y));
+    packed.Tangent.z = int16_t(glm::packSnorm1x16(vertex.Tangent.z));
+    packed.Tangent.w = int16_t(glm::packSnorm1x16(vertex.Tangent.w < 0.0f ? -1.0f : 1.0f));
+
+    packed.TexCoord.s = glm::packHalf1x16(vertex.TexCoord.s);
+    packed.TexCoord.t = glm::packHalf1x16(vertex.TexCoord.t);
+
+    packed.color = vertex.color.value_or(Color{255, 255, 255, 255});
+
+    return packed;
 }
 
-VkPipelineVertexInputStateCreateInfo SceneVertex::get_vertex_input_state(bool useColor)
+//------------------------------------------
+// SceneVertexStreams
+
+void SceneVertexStreams::store(uint32_t index, SceneVertex const &vertex, char *base) const
 {
-    auto [bindings, attributes] = get_binding_and_attribute_descriptions(useColor);
+    ScenePosition position{vertex.Position.x, vertex.Position.y, vertex.Position.z};
+    std::memcpy(base + size_t(index) * sizeof(ScenePosition), &position, sizeof(position));
+
+    char *attribute = base + attributes_offset() + size_t(index) * attribute_stride();
+    if (packed)
+    {
+        PackedSceneAttributes attributes = PackedSceneAttributes::pack(vertex);
+        std::memcpy(attribute, &attributes, sizeof(attributes));
+    }
+    else
+    {
+        SceneAttributes attributes = SceneAttributes::from(vertex);
+        std::memcpy(attribute, &attributes, sizeof(attributes));
+    }
+}
+
+void SceneVertexStreams::clear(uint32_t first, uint32_t n, char *base) const
+{
+    std::memset(base + size_t(first) * sizeof(ScenePosition), 0, size_t(n) * sizeof(ScenePosition));
+    std::memset(base + attributes_offset() + size_t(first) * attribute_stride(), 0, size_t(n) * attribute_stride());
+}
+
+static std::array<VkVertexInputBindingDescription, 1> position_bindings{
+    VkVertexInputBindingDescription{
+        .binding = 0,
+        .stride = sizeof(ScenePosition),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    },
+};
+
+static std::array<VkVertexInputAttributeDescription, 1> position_attributes{
+    VkVertexInputAttributeDescription{
+        .location = 0,
+        .binding = 0,
+        .format = VK_FORMAT_R32G32B32_SFLOAT,
+        .offset = 0,
+    },
+};
+
+const VkPipelineVertexInputStateCreateInfo SceneVertexStreams::position_input_state{
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount = uint32_t(position_bindings.size()),
+    .pVertexBindingDescriptions = position_bindings.data(),
+    .vertexAttributeDescriptionCount = uint32_t(position_attributes.size()),
+    .pVertexAttributeDescriptions = position_attributes.data(),
+};
+
+static std::array<VkVertexInputBindingDescription, 2> attributes_bindings{
+    position_bindings[0],
+    VkVertexInputBindingDescription{
+        .binding = 1,
+        .stride = sizeof(SceneAttributes),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    },
+};
+
+// (color is stored in the attribute stream but not read by real_objects.vert, so it has no location here)
+static std::array<VkVertexInputAttributeDescription, 4> attributes_attributes{
+    position_attributes[0],
+    VkVertexInputAttributeDescription{
+        .location = 1,
+        .binding = 1,
+        .format = VK_FORMAT_R32G32B32_SFLOAT,
+        .offset = offsetof(SceneAttributes, Normal),
+    },
+    VkVertexInputAttributeDescription{
+        .location = 2,
+        .binding = 1,
+        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset = offsetof(SceneAttributes, Tangent),
+    },
+    VkVertexInputAttributeDescription{
+        .location = 3,
+        .binding = 1,
+        .format = VK_FORMAT_R32G32_SFLOAT,
+        .offset = offsetof(SceneAttributes, TexCoord),
+    },
+};
+
+const VkPipelineVertexInputStateCreateInfo SceneVertexStreams::attributes_input_state{
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount = uint32_t(attributes_bindings.size()),
+    .pVertexBindingDescriptions = attributes_bindings.data(),
+    .vertexAttributeDescriptionCount = uint32_t(attributes_attributes.size()),
+    .pVertexAttributeDescriptions = attributes_attributes.data(),
+};
+
+static std::array<VkVertexInputBindingDescription, 2> packed_bindings{
+    position_bindings[0],
+    VkVertexInputBindingDescription{
+        .binding = 1,
+        .stride = sizeof(PackedSceneAttributes),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    },
+};
 
-    VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-    vertex_input_info.pVertexBindingDescriptions = bindings.data();
-    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-    vertex_input_info.pVertexAttributeDescriptions = attributes.data();
+// same locations as above; real_objects.vert decodes the normal when PACKED_VERTICES is set:
+static std::array<VkVertexInputAttributeDescription, 4> packed_attributes{
+    position_attributes[0],
+    VkVertexInputAttributeDescription{
+        .location = 1,
+        .binding = 1,
+        .format = VK_FORMAT_R16G16_SNORM,
+        .offset = offsetof(PackedSceneAttributes, Normal),
+    },
+    VkVertexInputAttributeDescription{
+        .location = 2,
+        .binding = 1,
+        .format = VK_FORMAT_R16G16B16A16_SNORM,
+        .offset = offsetof(PackedSceneAttributes, Tangent),
+    },
+    VkVertexInputAttributeDescription{
+        .location = 3,
+        .binding = 1,
+        .format = VK_FORMAT_R16G16_SFLOAT,
+        .offset = offsetof(PackedSceneAttributes, TexCoord),
+    },
+};
 
-    return vertex_input_info;
-}
\ No newline at end of file
+const VkPipelineVertexInputStateCreateInfo SceneVertexStreams::packed_attributes_input_state{
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount = uint32_t(packed_bindings.size()),
+    .pVertexBindingDescriptions = packed_bindings.data(),
+    .vertexAttributeDescriptionCount = uint32_t(packed_attributes.size()),
+    .pVertexAttributeDescriptions = packed_attributes.data(),
+};
@@ -34,10 +34,81 @@ struct SceneVertex
     } TexCoord;
 
     std::optional<struct Color> color;
+};
+
+// The scene vertex buffer holds split streams: all vertex positions first (binding 0), then all
+//  remaining attributes (binding 1), so position-only passes fetch 12 bytes per vertex.
+struct ScenePosition
+{
+    float x, y, z;
+};
+static_assert(sizeof(ScenePosition) == 3 * 4, "ScenePosition is packed.");
+
+// full-precision attribute stream element:
+struct SceneAttributes
+{
+    struct
+    {
+        float x, y, z;
+    } Normal;
+
+    struct
+    {
+        float x, y, z, w;
+    } Tangent;
+
+    struct
+    {
+        float s, t;
+    } TexCoord;
+
+    struct Color color; // always present (white if the mesh has no colors)
+
+    static SceneAttributes from(SceneVertex const &vertex);
+};
+static_assert(sizeof(SceneAttributes) == 3 * 4 + 4 * 4 + 2 * 4 + 4, "SceneAttributes is packed.");
+
+// compact attribute stream element, used with `--packed-vertices`:
+struct PackedSceneAttributes
+{
+    struct
+    {
+        int16_t x, y; // octahedral encoding of the unit normal, as snorm16
+    } Normal;
+
+    struct
+    {
+        int16_t x, y, z, w; // snorm16; w is the bitangent sign
+    } Tangent;
+
+    struct
+    {
+        uint16_t s, t; // fp16
+    } TexCoord;
+
+    struct Color color; // always present (white if the mesh has no colors)
+
+    static PackedSceneAttributes pack(SceneVertex const &vertex);
+};
+static_assert(sizeof(PackedSceneAttributes) == 2 * 2 + 4 * 2 + 2 * 2 + 4, "PackedSceneAttributes is packed.");
+
+// Layout of a scene vertex buffer holding 'count' vertices:
+struct SceneVertexStreams
+{
+    uint32_t count = 0;
+    bool packed = false; // attributes are PackedSceneAttributes (otherwise SceneAttributes)
+
+    size_t attribute_stride() const { return packed ? sizeof(PackedSceneAttributes) : sizeof(SceneAttributes); }
+    size_t attributes_offset() const { return (size_t(count) * sizeof(ScenePosition) + 15) & ~size_t(15); }
+    size_t total_bytes() const { return attributes_offset() + size_t(count) * attribute_stride(); }
 
-    static VkPipelineVertexInputStateCreateInfo get_vertex_input_state(bool useColor);
+    // write 'vertex' as vertex number 'index' of the buffer starting at 'base':
+    void store(uint32_t index, SceneVertex const &vertex, char *base) const;
+    // zero vertices [first, first + n) of the buffer starting at 'base':
+    void clear(uint32_t first, uint32_t n, char *base) const;
 
-    static std::pair<std::vector<VkVertexInputBindingDescription>,
-                     std::vector<VkVertexInputAttributeDescription>>
-    get_binding_and_attribute_descriptions(bool useColor);
+    // pipeline vertex input states for buffers laid out like this:
+    static const VkPipelineVertexInputStateCreateInfo position_input_state;          // binding 0 only
+    static const VkPipelineVertexInputStateCreateInfo attributes_input_state;        // bindings 0 + 1 (SceneAttributes)
+    static const VkPipelineVertexInputStateCreateInfo packed_attributes_input_state; // bindings 0 + 1 (PackedSceneAttributes)
 };
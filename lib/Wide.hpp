@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIDE_SSE2
+#include <emmintrin.h>
+#endif
+
+// One SIMD register of float lanes, and the handful of operations the batched kernels (BoxBatch, DriverBatch,
+//  OcclusionBuffer) need. Lanes are 8 wide when built with AVX2 (e.g. -mavx2 or /arch:AVX2), 4 wide with SSE2
+//  (any x86-64), and 1 elsewhere. Comparisons return all-ones lanes for true, which select and sign_bits read.
+namespace simd
+{
+#if defined(__AVX2__)
+    using Wide = __m256;
+    constexpr uint32_t WideLanes = 8;
+    inline Wide load(float const *p) { return _mm256_loadu_ps(p); }
+    inline void store(float *p, Wide v) { _mm256_storeu_ps(p, v); }
+    inline Wide splat(float f) { return _mm256_set1_ps(f); }
+    inline Wide add(Wide a, Wide b) { return _mm256_add_ps(a, b); }
+    inline Wide sub(Wide a, Wide b) { return _mm256_sub_ps(a, b); }
+    inline Wide mul(Wide a, Wide b) { return _mm256_mul_ps(a, b); }
+    inline Wide div(Wide a, Wide b) { return _mm256_div_ps(a, b); }
+    inline Wide min(Wide a, Wide b) { return _mm256_min_ps(a, b); }
+    inline Wide sqrt(Wide a) { return _mm256_sqrt_ps(a); }
+    inline Wide bit_and(Wide a, Wide b) { return _mm256_and_ps(a, b); }
+    inline Wide bit_or(Wide a, Wide b) { return _mm256_or_ps(a, b); }
+    inline Wide bit_xor(Wide a, Wide b) { return _mm256_xor_ps(a, b); }
+    inline Wide less(Wide a, Wide b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    inline Wide greater(Wide a, Wide b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline Wide select(Wide mask, Wide a, Wide b) { return _mm256_blendv_ps(b, a, mask); }
+    inline uint32_t sign_bits(Wide a) { return uint32_t(_mm256_movemask_ps(a)); }
+#elif defined(WIDE_SSE2)
+    using Wide = __m128;
+    constexpr uint32_t WideLanes = 4;
+    inline Wide load(float const *p) { return _mm_loadu_ps(p); }
+    inline void store(float *p, Wide v) { _mm_storeu_ps(p, v); }
+    inline Wide splat(float f) { return _mm_set1_ps(f); }
+    inline Wide add(Wide a, Wide b) { return _mm_add_ps(a, b); }
+    inline Wide sub(Wide a, Wide b) { return _mm_sub_ps(a, b); }
+    inline Wide mul(Wide a, Wide b) { return _mm_mul_ps(a, b); }
+    inline Wide div(Wide a, Wide b) { return _mm_div_ps(a, b); }
+    inline Wide min(Wide a, Wide b) { return _mm_min_ps(a, b); }
+    inline Wide sqrt(Wide a) { return _mm_sqrt_ps(a); }
+    inline Wide bit_and(Wide a, Wide b) { return _mm_and_ps(a, b); }
+    inline Wide bit_or(Wide a, Wide b) { return _mm_or_ps(a, b); }
+    inline Wide bit_xor(Wide a, Wide b) { return _mm_xor_ps(a, b); }
+    inline Wide less(Wide a, Wide b) { return _mm_cmplt_ps(a, b); }
+    inline Wide greater(Wide a, Wide b) { return _mm_cmpgt_ps(a, b); }
+    inline Wide select(Wide mask, Wide a, Wide b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline uint32_t sign_bits(Wide a) { return uint32_t(_mm_movemask_ps(a)); }
+#else
+    // (no SIMD instruction set known to this file -- e.g. arm64 -- so lanes are plain floats):
+    using Wide = float;
+    constexpr uint32_t WideLanes = 1;
+    inline Wide load(float const *p) { return *p; }
+    inline void store(float *p, Wide v) { *p = v; }
+    inline Wide splat(float f) { return f; }
+    inline Wide add(Wide a, Wide b) { return a + b; }
+    inline Wide sub(Wide a, Wide b) { return a - b; }
+    inline Wide mul(Wide a, Wide b) { return a * b; }
+    inline Wide div(Wide a, Wide b) { return a / b; }
+    inline Wide min(Wide a, Wide b) { return std::min(a, b); }
+    inline Wide sqrt(Wide a) { return std::sqrt(a); }
+    inline Wide bit_and(Wide a, Wide b) { return std::bit_cast<float>(std::bit_cast<uint32_t>(a) & std::bit_cast<uint32_t>(b)); }
+    inline Wide bit_or(Wide a, Wide b) { return std::bit_cast<float>(std::bit_cast<uint32_t>(a) | std::bit_cast<uint32_t>(b)); }
+    inline Wide bit_xor(Wide a, Wide b) { return std::bit_cast<float>(std::bit_cast<uint32_t>(a) ^ std::bit_cast<uint32_t>(b)); }
+    inline Wide less(Wide a, Wide b) { return std::bit_cast<float>(a < b ? ~0u : 0u); }
+    inline Wide greater(Wide a, Wide b) { return std::bit_cast<float>(a > b ? ~0u : 0u); }
+    inline Wide select(Wide mask, Wide a, Wide b) { return std::bit_cast<uint32_t>(mask) ? a : b; }
+    inline uint32_t sign_bits(Wide a) { return std::bit_cast<uint32_t>(a) >> 31; }
+#endif
+}
@@ -0,0 +1,115 @@
+#include "../Tutorial.hpp"
+#include "../helper/Helpers.hpp"
+#include "../helper/VK.hpp"
+
+static uint32_t comp_code[] =
+#include "../spv/shaders/cull.comp.inl"
+    ;
+
+// (cull.comp compiled with OCCLUSION defined)
+static uint32_t occlusion_comp_code[] =
+#include "../spv/shaders/cull_occlusion.comp.inl"
+    ;
+
+void Tutorial::CullPipeline::create(RTG &rtg, bool compact, bool occlusion)
+{
+    VkShaderModule comp_module = (occlusion ? rtg.helpers.create_shader_module(occlusion_comp_code) : rtg.helpers.create_shader_module(comp_code));
+
+    { // the set0_Objects layout holds objects, worlds, instance Transforms, draw commands, and draw counts, all in storage buffers
+        //  (and, with occlusion, visibility in a storage buffer and the depth pyramid as a sampled image):
+        std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+        for (uint32_t b = 0; b < bindings.size(); ++b)
+        {
+            bindings[b] = VkDescriptorSetLayoutBinding{
+                .binding = b,
+                .descriptorType = (b == 6 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT};
+        }
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = (occlusion ? 7u : 5u),
+            .pBindings = bindings.data(),
+        };
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Objects));
+    }
+
+    {
+        // create pipeline layout:
+        std::array<VkDescriptorSetLayout, 1> layouts{
+            set0_Objects,
+        };
+
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push),
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &range,
+        };
+
+        VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
+    }
+
+    { // create pipeline, compacting visible draws if they will be drawn with a GPU-written count:
+        VkBool32 compact_value = compact ? VK_TRUE : VK_FALSE;
+
+        VkSpecializationMapEntry specialization_entry{
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(VkBool32),
+        };
+
+        VkSpecializationInfo specialization_info{
+            .mapEntryCount = 1,
+            .pMapEntries = &specialization_entry,
+            .dataSize = sizeof(VkBool32),
+            .pData = &compact_value,
+        };
+
+        VkComputePipelineCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp_module,
+                .pName = "main",
+                .pSpecializationInfo = &specialization_info},
+            .layout = layout,
+        };
+
+        VK(vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+    }
+
+    // module no longer needed now that the pipeline is created:
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+}
+
+void Tutorial::CullPipeline::destroy(RTG &rtg)
+{
+    if (set0_Objects != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set0_Objects, nullptr);
+        set0_Objects = VK_NULL_HANDLE;
+    }
+
+    if (layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, handle, nullptr);
+        handle = VK_NULL_HANDLE;
+    }
+}
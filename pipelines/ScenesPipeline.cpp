@@ -10,10 +10,15 @@ static uint32_t frag_code[] =
 #include "../spv/shaders/real_objects.frag.inl"
     ;
 
+static uint32_t depth_vert_code[] =
+#include "../spv/shaders/real_objects_depth.vert.inl"
+    ;
+
 void Tutorial::ScenesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_t subpass)
 {
     VkShaderModule vert_module = rtg.helpers.create_shader_module(vert_code);
     VkShaderModule frag_module = rtg.helpers.create_shader_module(frag_code);
+    VkShaderModule depth_vert_module = rtg.helpers.create_shader_module(depth_vert_code);
 
     { // the set0_World layout holds world info in a uniform buffer used in the fragment shader:
         std::array<VkDescriptorSetLayoutBinding, 1> bindings{
@@ -96,13 +101,30 @@ void Tutorial::ScenesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32
 
     { // create pipeline:
 
+        // the vertex shader decodes packed vertices if PACKED_VERTICES (constant_id 0) is set:
+        VkBool32 packed_vertices = rtg.configuration.packed_vertices ? VK_TRUE : VK_FALSE;
+
+        VkSpecializationMapEntry specialization_entry{
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(VkBool32),
+        };
+
+        VkSpecializationInfo specialization_info{
+            .mapEntryCount = 1,
+            .pMapEntries = &specialization_entry,
+            .dataSize = sizeof(packed_vertices),
+            .pData = &packed_vertices,
+        };
+
         // shader code for vertex and fragment pipeline stages:
         std::array<VkPipelineShaderStageCreateInfo, 2> stages{
             VkPipelineShaderStageCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_VERTEX_BIT,
                 .module = vert_module,
-                .pName = "main"},
+                .pName = "main",
+                .pSpecializationInfo = &specialization_info},
             VkPipelineShaderStageCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -152,12 +174,12 @@ void Tutorial::ScenesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32
             .sampleShadingEnable = VK_FALSE,
         };
 
-        // depth test will be less, and stencil test will be disabled:
+        // depth test will be less (or less-or-equal, to pass where a depth prepass already drew), and stencil test will be disabled:
         VkPipelineDepthStencilStateCreateInfo depth_stencil_state{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
             .depthTestEnable = VK_TRUE,
             .depthWriteEnable = VK_TRUE,
-            .depthCompareOp = VK_COMPARE_OP_LESS,
+            .depthCompareOp = (rtg.configuration.depth_prepass ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS),
             .depthBoundsTestEnable = VK_FALSE,
             .stencilTestEnable = VK_FALSE,
         };
@@ -177,8 +199,8 @@ void Tutorial::ScenesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32
             .blendConstants{0.0f, 0.0f, 0.0f, 0.0f},
         };
 
-        // set default false
-        VkPipelineVertexInputStateCreateInfo vertex_input_state = SceneVertex::get_vertex_input_state(false);
+        // position stream (binding 0) plus full or packed attribute stream (binding 1):
+        VkPipelineVertexInputStateCreateInfo const &vertex_input_state = (rtg.configuration.packed_vertices ? SceneVertexStreams::packed_attributes_input_state : SceneVertexStreams::attributes_input_state);
 
         // all of the above structures get bundled together into one very large create_info:
         VkGraphicsPipelineCreateInfo create_info{
@@ -199,9 +221,40 @@ void Tutorial::ScenesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32
         };
 
         VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &handle));
+
+        { // the depth-only variant: same layout and fixed-function state, but only a vertex shader reading positions:
+            VkPipelineShaderStageCreateInfo depth_stage{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = depth_vert_module,
+                .pName = "main"};
+
+            // depth is always written with a less test; color is left untouched:
+            VkPipelineDepthStencilStateCreateInfo depth_only_stencil_state = depth_stencil_state;
+            depth_only_stencil_state.depthCompareOp = VK_COMPARE_OP_LESS;
+
+            std::array<VkPipelineColorBlendAttachmentState, 1> depth_only_attachment_states{
+                VkPipelineColorBlendAttachmentState{
+                    .blendEnable = VK_FALSE,
+                    .colorWriteMask = 0,
+                },
+            };
+            VkPipelineColorBlendStateCreateInfo depth_only_color_blend_state = color_blend_state;
+            depth_only_color_blend_state.pAttachments = depth_only_attachment_states.data();
+
+            VkGraphicsPipelineCreateInfo depth_only_create_info = create_info;
+            depth_only_create_info.stageCount = 1;
+            depth_only_create_info.pStages = &depth_stage;
+            depth_only_create_info.pVertexInputState = &SceneVertexStreams::position_input_state;
+            depth_only_create_info.pDepthStencilState = &depth_only_stencil_state;
+            depth_only_create_info.pColorBlendState = &depth_only_color_blend_state;
+
+            VK(vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &depth_only_create_info, nullptr, &depth_only));
+        }
     }
 
     // modules no longer needed now that pipeline is created:
+    vkDestroyShaderModule(rtg.device, depth_vert_module, nullptr);
     vkDestroyShaderModule(rtg.device, frag_module, nullptr);
     vkDestroyShaderModule(rtg.device, vert_module, nullptr);
 }
@@ -232,6 +285,12 @@ void Tutorial::ScenesPipeline::destroy(RTG &rtg)
         layout = VK_NULL_HANDLE;
     }
 
+    if (depth_only != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, depth_only, nullptr);
+        depth_only = VK_NULL_HANDLE;
+    }
+
     if (handle != VK_NULL_HANDLE)
     {
         vkDestroyPipeline(rtg.device, handle, nullptr);
@@ -0,0 +1,119 @@
+#include "../Tutorial.hpp"
+#include "../helper/Helpers.hpp"
+#include "../helper/VK.hpp"
+
+static uint32_t comp_code[] =
+#include "../spv/shaders/transforms.comp.inl"
+    ;
+
+void Tutorial::TransformsPipeline::create(RTG &rtg)
+{
+    VkShaderModule comp_module = rtg.helpers.create_shader_module(comp_code);
+
+    { // the set0_Nodes layout holds locals, levels, worlds, instance nodes, and instance Transforms, all in storage buffers:
+        std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+        for (uint32_t b = 0; b < bindings.size(); ++b)
+        {
+            bindings[b] = VkDescriptorSetLayoutBinding{
+                .binding = b,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT};
+        }
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Nodes));
+    }
+
+    {
+        // create pipeline layout:
+        std::array<VkDescriptorSetLayout, 1> layouts{
+            set0_Nodes,
+        };
+
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push),
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &range,
+        };
+
+        VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
+    }
+
+    { // create pipelines: the same shader, specialized for levels (INSTANCES = false) and instances (INSTANCES = true):
+        std::array<VkBool32, 2> variants{VK_FALSE, VK_TRUE};
+        std::array<VkPipeline *, 2> outputs{&handle, &instances};
+
+        for (uint32_t v = 0; v < variants.size(); ++v)
+        {
+            VkSpecializationMapEntry specialization_entry{
+                .constantID = 0,
+                .offset = 0,
+                .size = sizeof(VkBool32),
+            };
+
+            VkSpecializationInfo specialization_info{
+                .mapEntryCount = 1,
+                .pMapEntries = &specialization_entry,
+                .dataSize = sizeof(VkBool32),
+                .pData = &variants[v],
+            };
+
+            VkComputePipelineCreateInfo create_info{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage = VkPipelineShaderStageCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = comp_module,
+                    .pName = "main",
+                    .pSpecializationInfo = &specialization_info},
+                .layout = layout,
+            };
+
+            VK(vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, outputs[v]));
+        }
+    }
+
+    // module no longer needed now that the pipelines are created:
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+}
+
+void Tutorial::TransformsPipeline::destroy(RTG &rtg)
+{
+    if (set0_Nodes != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set0_Nodes, nullptr);
+        set0_Nodes = VK_NULL_HANDLE;
+    }
+
+    if (layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (instances != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, instances, nullptr);
+        instances = VK_NULL_HANDLE;
+    }
+
+    if (handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, handle, nullptr);
+        handle = VK_NULL_HANDLE;
+    }
+}
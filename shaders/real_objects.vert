@@ -1,5 +1,8 @@
 #version 450
 
+// set by ScenesPipeline when the attribute stream holds PackedSceneAttributes data:
+layout(constant_id = 0) const bool PACKED_VERTICES = false;
+
 layout(push_constant) uniform PushConstants {
     bool useColor;
 } pushConstants;
@@ -16,7 +19,7 @@ layout(set=1, binding=0, std140) readonly buffer Transforms {
 };
 
 layout(location=0) in vec3 Position;
-layout(location=1) in vec3 Normal;
+layout(location=1) in vec3 Normal; // (packed: octahedral-encoded in .xy)
 layout(location=2) in vec4 Tangent;
 layout(location=3) in vec2 TexCoord;
 
@@ -25,15 +28,27 @@ layout(location=4) in vec4 Color;
 layout(location=4) out vec4 outColor;
 #endif
 
+// (must match real_objects_depth.vert exactly, so a depth prepass lines up)
+invariant gl_Position;
+
 layout(location=0) out vec3 position;
 layout(location=1) out vec3 normal;
 layout(location=2) out vec4 tangent;
 layout(location=3) out vec2 texCoord;
 
+vec3 oct_decode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+
 void main() {
+    vec3 local_normal = PACKED_VERTICES ? oct_decode(Normal.xy) : Normal;
+
     gl_Position = TRANSFORMS[gl_InstanceIndex].CLIP_FROM_LOCAL * vec4(Position, 1.0);
     position = mat4x3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL) * vec4(Position, 1.0);;
-    normal = mat3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL_NORMAL) * Normal;
+    normal = mat3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL_NORMAL) * local_normal;
     tangent = vec4(mat3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL_TANGENT) * Tangent.xyz, Tangent.w);
     texCoord = TexCoord;
 
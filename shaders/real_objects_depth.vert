@@ -0,0 +1,22 @@
+#version 450
+
+struct Transform {
+	mat4 CLIP_FROM_LOCAL;
+	mat4 WORLD_FROM_LOCAL;
+	mat4 WORLD_FROM_LOCAL_NORMAL;
+    mat4 WORLD_FROM_LOCAL_TANGENT;
+};
+
+layout(set=1, binding=0, std140) readonly buffer Transforms {
+	Transform TRANSFORMS[];
+};
+
+// only the position stream is bound:
+layout(location=0) in vec3 Position;
+
+// (must match real_objects.vert exactly, so a depth prepass lines up)
+invariant gl_Position;
+
+void main() {
+    gl_Position = TRANSFORMS[gl_InstanceIndex].CLIP_FROM_LOCAL * vec4(Position, 1.0);
+}